@@ -0,0 +1,164 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+/// Kind of an anomaly found by StreamingAnomalyDetector.
+enum class AnomalyKind : uint8_t {
+  NONE,
+  OUT_OF_RANGE,  // Outside of the fixed limits, e.g., of a standard.
+  OUTLIER  // Unusual compared to the recent samples (rolling z-score).
+};
+
+
+/// Streaming anomaly detector for a single quantity, e.g., the grid
+/// frequency. Each sample is checked against fixed limits and against the
+/// exponentially weighted moving mean and variance of the previous samples
+/// (i.e., a rolling z-score), which are then updated in O(1). Samples out of
+/// range do not enter the statistics. An anomaly is only reported at its
+/// onset, i.e., not again for the directly following anomalous samples.
+class StreamingAnomalyDetector {
+ public:
+  /// Ctor expecting the fixed limits, the smoothing factor of the moving
+  /// statistics, the z-score threshold, the minimum standard deviation
+  /// (against alarms on very steady values), and the number of samples
+  /// before the z-score is used.
+  StreamingAnomalyDetector(float minValue, float maxValue, float smoothing, float zThreshold, float minStdDev, int warmupCount)
+  : minValue(minValue), maxValue(maxValue), smoothing(smoothing), zThreshold(zThreshold), minStdDev(minStdDev), warmupCount(warmupCount) {}
+
+
+  /// Checks and adds the given sample. Returns the kind of anomaly if one
+  /// starts with this sample, otherwise AnomalyKind::NONE.
+  AnomalyKind addSample(float value) {
+    AnomalyKind kind = AnomalyKind::NONE;
+    if (value < minValue || value > maxValue) {
+      kind = AnomalyKind::OUT_OF_RANGE;
+    } else {
+      if (count >= warmupCount) {
+        float stdDev = std::max(std::sqrt(variance), minStdDev);
+        if (std::fabs(value - mean) / stdDev > zThreshold) {
+          kind = AnomalyKind::OUTLIER;
+        }
+      }
+      if (count == 0) {
+        mean = value;
+      } else {
+        float difference = value - mean;
+        float increment = smoothing * difference;
+        mean += increment;
+        variance = (1.0f - smoothing) * (variance + difference * increment);
+      }
+      ++count;
+    }
+
+    bool isOnset = (kind != AnomalyKind::NONE && !isInAnomaly);
+    isInAnomaly = (kind != AnomalyKind::NONE);
+    return isOnset ? kind : AnomalyKind::NONE;
+  }
+
+
+  float getMean() const {
+    return mean;
+  }
+
+ private:
+  const float minValue;
+  const float maxValue;
+  const float smoothing;
+  const float zThreshold;
+  const float minStdDev;
+  const int warmupCount;
+  int count = 0;
+  float mean = 0.0f;
+  float variance = 0.0f;
+  bool isInAnomaly = false;
+};
+
+
+/// Event of an anomaly, 12 bytes each.
+struct AnomalyEvent {
+  uint32_t timestamp;  // Seconds since epoch.
+  float value;
+  uint8_t source;  // Index of the detector, e.g., of the monitored quantity.
+  AnomalyKind kind;
+};
+
+
+/// Compact log of the last EVENT_COUNT anomaly events in a ring buffer. The
+/// state is a plain struct so that it can be persisted as is, e.g., in the
+/// NVS (cf. DailyYieldHistory).
+class AnomalyEventLog {
+ public:
+  static const int EVENT_COUNT = 32;
+
+  /// Persistent state.
+  struct State {
+    uint32_t version;
+    uint32_t totalCount;  // Number of events ever added, the newest at (totalCount - 1) % EVENT_COUNT.
+    AnomalyEvent events[EVENT_COUNT];
+  };
+
+
+  AnomalyEventLog() {
+    state.version = STATE_VERSION;
+    state.totalCount = 0;
+  }
+
+
+  const State& getState() const {
+    return state;
+  }
+
+
+  /// Restores the given persisted state. Returns false if the state is not
+  /// compatible and thus ignored.
+  bool restoreState(const State& persistedState) {
+    if (persistedState.version != STATE_VERSION) {
+      return false;
+    }
+    state = persistedState;
+    return true;
+  }
+
+
+  void add(const AnomalyEvent& event) {
+    state.events[state.totalCount % EVENT_COUNT] = event;
+    ++state.totalCount;
+  }
+
+
+  /// Returns the logged events of the given source not before the given
+  /// timestamp, oldest first.
+  std::vector<AnomalyEvent> getEvents(uint8_t source, uint32_t sinceTimestamp) const {
+    std::vector<AnomalyEvent> result;
+    uint32_t count = std::min<uint32_t>(state.totalCount, EVENT_COUNT);
+    for (uint32_t index = state.totalCount - count; index < state.totalCount; ++index) {
+      const AnomalyEvent& event = state.events[index % EVENT_COUNT];
+      if (event.source == source && event.timestamp >= sinceTimestamp) {
+        result.push_back(event);
+      }
+    }
+    return result;
+  }
+
+
+  /// Returns the timestamp of the newest logged event, or 0 if there is none.
+  uint32_t getNewestTimestamp() const {
+    return (state.totalCount > 0) ? state.events[(state.totalCount - 1) % EVENT_COUNT].timestamp : 0;
+  }
+
+ private:
+  static const uint32_t STATE_VERSION = 1;
+
+  State state;
+};
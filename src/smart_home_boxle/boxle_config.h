@@ -0,0 +1,161 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <cstdint>
+#include <cstring>
+
+#include <Preferences.h>
+
+
+/// Runtime configuration of the box. It is stored in the NVS as a single
+/// binary record (cf. BoxleConfigStore) and loaded once at boot. All numeric
+/// settings are 16-bit values to keep the record compact.
+struct BoxleConfig {
+  char wifiSsid[33];
+  char wifiPassword[65];
+  char thingSpeakChannels[64];  // Comma-separated list of channel IDs.
+  uint16_t maxDataAgeSeconds;  // Older data is considered as stale.
+  uint16_t redrawIntervalSeconds;
+  uint16_t ammeterFullScaleWatts;  // P_AC at full deflection of the ammeter.
+  uint16_t pacReferenceWatts;  // P_AC of the red reference line in the plot.
+  uint16_t pacPlotMaxWatts;  // Upper limit of the P_AC plot, 0 for automatic.
+  uint16_t ammeterPeakMillis;  // Time to the first peak of the step response, 0 if unknown.
+  uint16_t ammeterSettlingMillis;  // Settling time of the step response, 0 if unknown.
+};
+
+
+/// Describes a numeric setting of BoxleConfig for generic handling, e.g.,
+/// by a web form.
+struct BoxleConfigField {
+  const char* name;
+  const char* label;
+  uint16_t BoxleConfig::* member;
+  uint16_t minValue;
+  uint16_t maxValue;
+};
+
+
+/// List of all numeric settings of BoxleConfig.
+const BoxleConfigField BOXLE_CONFIG_FIELDS[] = {
+  {"maxDataAge", "Max. data age [s]", &BoxleConfig::maxDataAgeSeconds, 60, 7200},
+  {"redrawInterval", "Redraw interval [s]", &BoxleConfig::redrawIntervalSeconds, 60, 3600},
+  {"ammeterFullScale", "Ammeter full scale [W]", &BoxleConfig::ammeterFullScaleWatts, 10, 60000},
+  {"pacReference", "P_AC reference line [W]", &BoxleConfig::pacReferenceWatts, 0, 60000},
+  {"pacPlotMax", "P_AC plot maximum [W], 0 = auto", &BoxleConfig::pacPlotMaxWatts, 0, 60000},
+  {"ammeterPeak", "Ammeter step peak time [ms], 0 = no shaping", &BoxleConfig::ammeterPeakMillis, 0, 5000},
+  {"ammeterSettling", "Ammeter step settling time [ms]", &BoxleConfig::ammeterSettlingMillis, 0, 30000},
+};
+
+
+/// Loads and saves the BoxleConfig as binary record in the NVS. The record
+/// consists of a schema version, the size of the configuration, the
+/// configuration itself, and a checksum. Records of an older version are
+/// migrated, i.e., the fields they contain are taken over and the others
+/// keep their defaults. Records of a newer version or with an inconsistent
+/// size or a wrong checksum are ignored, i.e., the defaults are used.
+class BoxleConfigStore {
+ public:
+  /// Version of the binary schema, to be incremented on each change of
+  /// BoxleConfig. New fields have to be appended so that older records
+  /// are a prefix of the current one.
+  static const uint16_t SCHEMA_VERSION = 2;
+
+
+  explicit BoxleConfigStore(Preferences& preferences) : preferences(preferences) {}
+
+
+  /// Loads the configuration into the given struct, which should contain
+  /// the defaults for the fields not stored in an older record. Returns
+  /// false (leaving the struct untouched) if there is no valid record.
+  bool load(BoxleConfig& config) {
+    uint8_t buffer[sizeof(Record)];
+    size_t length = preferences.getBytesLength(KEY);
+    if (length < HEADER_SIZE + CHECKSUM_SIZE || length > sizeof(buffer) || preferences.getBytes(KEY, buffer, length) != length) {
+      return false;
+    }
+    uint16_t version;
+    uint16_t size;
+    memcpy(&version, buffer, sizeof(version));
+    memcpy(&size, buffer + sizeof(version), sizeof(size));
+    if (version == 0 || version > SCHEMA_VERSION || length != HEADER_SIZE + size + CHECKSUM_SIZE) {
+      return false;
+    }
+    if ((version == SCHEMA_VERSION) ? (size != sizeof(BoxleConfig)) : (size >= sizeof(BoxleConfig))) {
+      return false;
+    }
+    uint32_t checksum;
+    memcpy(&checksum, buffer + HEADER_SIZE + size, sizeof(checksum));
+    if (checksum != computeChecksum(buffer + HEADER_SIZE, size)) {
+      return false;
+    }
+    memcpy(&config, buffer + HEADER_SIZE, size);
+    terminateStrings(config);
+    return true;
+  }
+
+
+  /// Saves the given configuration. Returns false if writing failed.
+  bool save(const BoxleConfig& config) {
+    BoxleConfig terminatedConfig = config;
+    terminateStrings(terminatedConfig);
+    Record record;
+    record.version = SCHEMA_VERSION;
+    record.size = sizeof(BoxleConfig);
+    record.config = terminatedConfig;
+    record.checksum = computeChecksum(reinterpret_cast<const uint8_t*>(&terminatedConfig), sizeof(BoxleConfig));
+    return preferences.putBytes(KEY, &record, sizeof(record)) == sizeof(record);
+  }
+
+
+  /// Removes the record, i.e., the defaults are used from the next load on.
+  void clear() {
+    preferences.remove(KEY);
+  }
+
+
+  /// Copies the given string into the given fixed-size field, truncating it
+  /// if necessary.
+  template <size_t N>
+  static void setString(char (&field)[N], const char* value) {
+    strncpy(field, value, N - 1);
+    field[N - 1] = '\0';
+  }
+
+ private:
+  static constexpr const char* KEY = "config";
+
+  struct __attribute__((packed)) Record {
+    uint16_t version;
+    uint16_t size;
+    BoxleConfig config;
+    uint32_t checksum;
+  };
+
+  static const size_t HEADER_SIZE = 2 * sizeof(uint16_t);
+  static const size_t CHECKSUM_SIZE = sizeof(uint32_t);
+
+  Preferences& preferences;
+
+
+  /// Computes the FNV-1a hash of the given bytes of a configuration.
+  static uint32_t computeChecksum(const uint8_t* bytes, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t index = 0; index < size; ++index) {
+      hash = (hash ^ bytes[index]) * 16777619u;
+    }
+    return hash;
+  }
+
+
+  static void terminateStrings(BoxleConfig& config) {
+    config.wifiSsid[sizeof(config.wifiSsid) - 1] = '\0';
+    config.wifiPassword[sizeof(config.wifiPassword) - 1] = '\0';
+    config.thingSpeakChannels[sizeof(config.thingSpeakChannels) - 1] = '\0';
+  }
+};
@@ -0,0 +1,133 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+
+
+/// Fast approximation of the AC power of a photovoltaic system under a
+/// clear sky, computed from the location, the date, and the orientation of
+/// the panels. The sun position follows the usual approximations for the
+/// declination and the equation of time, the direct irradiance the model by
+/// Meinel with the air mass by Kasten and Young, and the diffuse irradiance
+/// is assumed to be 10 % of the direct one. The result is scaled by the
+/// peak power and a constant performance ratio.
+///
+/// The power is computed once per (UTC) day into a table of SLOT_COUNT
+/// values and interpolated in between. For other days, the table of the
+/// cached day is used as approximation, e.g., for plots over several days.
+class ClearSkyModel {
+ public:
+  static const int SLOT_COUNT = 96;  // 15 minutes per slot.
+  static const int SECONDS_PER_DAY = 24 * 3600;
+
+
+  /// Ctor expecting the location (degrees, north and east positive), the
+  /// tilt of the panels (degrees from horizontal), their azimuth (degrees
+  /// from north, e.g., 180 for south), and the peak power (watts).
+  ClearSkyModel(float latitude, float longitude, float tilt, float azimuth, float peakWatts)
+  : latitude(toRadians(latitude)), longitude(longitude), tilt(toRadians(tilt)), azimuth(toRadians(azimuth)), peakWatts(peakWatts) {}
+
+
+  /// Computes the table for the day of the given timestamp unless it is
+  /// cached already. Returns true if the table has been computed.
+  bool updateDay(time_t timestamp) {
+    int32_t day = static_cast<int32_t>(timestamp / SECONDS_PER_DAY);
+    if (day == cachedDay) {
+      return false;
+    }
+    for (int slot = 0; slot < SLOT_COUNT; ++slot) {
+      time_t slotTimestamp = static_cast<time_t>(day) * SECONDS_PER_DAY + slot * (SECONDS_PER_DAY / SLOT_COUNT);
+      table[slot] = static_cast<uint16_t>(std::min(std::lround(computeWatts(slotTimestamp)), 65535L));
+    }
+    cachedDay = day;
+    return true;
+  }
+
+
+  /// Returns true if a table has been computed.
+  bool hasTable() const {
+    return cachedDay >= 0;
+  }
+
+
+  /// Returns the expected power at the time of day of the given timestamp,
+  /// or NaN if no table has been computed yet.
+  float getExpectedWatts(time_t timestamp) const {
+    if (!hasTable()) {
+      return NAN;
+    }
+    const int slotSeconds = SECONDS_PER_DAY / SLOT_COUNT;
+    int32_t secondOfDay = static_cast<int32_t>(((timestamp % SECONDS_PER_DAY) + SECONDS_PER_DAY) % SECONDS_PER_DAY);
+    int slot = secondOfDay / slotSeconds;
+    float fraction = static_cast<float>(secondOfDay % slotSeconds) / slotSeconds;
+    return table[slot] + (table[(slot + 1) % SLOT_COUNT] - table[slot]) * fraction;
+  }
+
+
+  /// Computes the expected power at the given timestamp without the table.
+  float computeWatts(time_t timestamp) const {
+    int dayOfYear = getDayOfYear(timestamp);
+    float declination = toRadians(23.45f) * std::sin(2.0f * static_cast<float>(M_PI) * (284 + dayOfYear) / 365.0f);
+    float b = 2.0f * static_cast<float>(M_PI) * (dayOfYear - 81) / 364.0f;
+    float equationOfTimeMinutes = 9.87f * std::sin(2.0f * b) - 7.53f * std::cos(b) - 1.5f * std::sin(b);
+    float utcMinutes = static_cast<float>(((timestamp % SECONDS_PER_DAY) + SECONDS_PER_DAY) % SECONDS_PER_DAY) / 60.0f;
+    float solarMinutes = utcMinutes + 4.0f * longitude + equationOfTimeMinutes;
+    float hourAngle = toRadians((solarMinutes / 60.0f - 12.0f) * 15.0f);
+
+    float cosZenith = std::sin(latitude) * std::sin(declination) + std::cos(latitude) * std::cos(declination) * std::cos(hourAngle);
+    if (cosZenith <= 0.01f) {
+      return 0.0f;
+    }
+    float zenith = std::acos(cosZenith);
+    float sinZenith = std::sin(zenith);
+    float cosSunAzimuth = (std::sin(declination) - cosZenith * std::sin(latitude)) / std::max(sinZenith * std::cos(latitude), 1e-6f);
+    float sunAzimuth = std::acos(std::min(std::max(cosSunAzimuth, -1.0f), 1.0f));  // From north.
+    if (hourAngle > 0.0f) {
+      sunAzimuth = 2.0f * static_cast<float>(M_PI) - sunAzimuth;  // Afternoon, i.e., west.
+    }
+
+    float airMass = 1.0f / (cosZenith + 0.50572f * std::pow(96.07995f - toDegrees(zenith), -1.6364f));
+    float directIrradiance = 1353.0f * std::pow(0.7f, std::pow(airMass, 0.678f));
+    float diffuseIrradiance = 0.1f * directIrradiance;
+    float cosIncidence = cosZenith * std::cos(tilt) + sinZenith * std::sin(tilt) * std::cos(sunAzimuth - azimuth);
+    float planeIrradiance = directIrradiance * std::max(cosIncidence, 0.0f) + diffuseIrradiance * (1.0f + std::cos(tilt)) / 2.0f;
+    return peakWatts * PERFORMANCE_RATIO * planeIrradiance / 1000.0f;
+  }
+
+ private:
+  static constexpr float PERFORMANCE_RATIO = 0.85f;  // Losses of temperature, wiring, and inverter.
+
+  const float latitude;  // Radians.
+  const float longitude;  // Degrees.
+  const float tilt;  // Radians.
+  const float azimuth;  // Radians.
+  const float peakWatts;
+  int32_t cachedDay = -1;
+  uint16_t table[SLOT_COUNT] = {};
+
+
+  static float toRadians(float degrees) {
+    return degrees * static_cast<float>(M_PI) / 180.0f;
+  }
+
+
+  static float toDegrees(float radians) {
+    return radians * 180.0f / static_cast<float>(M_PI);
+  }
+
+
+  static int getDayOfYear(time_t timestamp) {
+    tm date;
+    gmtime_r(&timestamp, &date);
+    return date.tm_yday + 1;
+  }
+};
@@ -0,0 +1,121 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "plot_utility.h"
+
+
+/// Computes the daily energy yields of the last days incrementally from the
+/// readings of the total yield counter. For each day, only the first reading
+/// after midnight is stored. Hence, the history grows by one value per day
+/// and does not need any query of the full history. The state is a plain
+/// struct so that it can be persisted as is, e.g., in the NVS.
+class DailyYieldHistory {
+ public:
+  /// Number of days for which the daily yield is available (including today).
+  static const int DAY_COUNT = 14;
+
+  /// Persistent state, i.e., the total yield at the start of the last days
+  /// in a ring buffer indexed by the day number modulo its size.
+  struct State {
+    uint32_t version;
+    int32_t today;
+    float startOfDayYields[DAY_COUNT + 1];
+  };
+
+
+  DailyYieldHistory() {
+    reset(0);
+  }
+
+
+  /// Returns the state for persisting it.
+  const State& getState() const {
+    return state;
+  }
+
+
+  /// Restores the given persisted state. Returns false if the state is not
+  /// compatible and thus ignored.
+  bool restoreState(const State& persistedState) {
+    if (persistedState.version != STATE_VERSION) {
+      return false;
+    }
+    state = persistedState;
+    return true;
+  }
+
+
+  /// Updates the history with the given reading of the total yield counter
+  /// on the given day (days since epoch). Returns true if a new day has
+  /// been started, i.e., if the state should be persisted.
+  bool update(int32_t day, float totalYield) {
+    latestYield = totalYield;
+    if (day == state.today) {
+      return false;
+    }
+    if (day < state.today || day - state.today > DAY_COUNT) {
+      reset(day);
+    } else {
+      for (int32_t skippedDay = state.today + 1; skippedDay < day; ++skippedDay) {
+        getStartOfDayYield(skippedDay) = NAN;
+      }
+    }
+    state.today = day;
+    getStartOfDayYield(day) = totalYield;
+    return true;
+  }
+
+
+  /// Returns the daily yields of the last days as points with the day
+  /// relative to today (i.e., -DAY_COUNT + 1 to 0) as x and the yield as y.
+  /// The yield of today is based on the latest reading. Days with missing
+  /// readings are omitted.
+  std::vector<PlotPoint> getDailyYields() const {
+    std::vector<PlotPoint> result;
+    result.reserve(DAY_COUNT);
+    for (int32_t offset = -DAY_COUNT + 1; offset <= 0; ++offset) {
+      int32_t day = state.today + offset;
+      float start = getStartOfDayYield(day);
+      float end = (offset == 0) ? latestYield : getStartOfDayYield(day + 1);
+      if (!std::isnan(start) && !std::isnan(end)) {
+        result.push_back({static_cast<double>(offset), std::max(0.0, static_cast<double>(end - start))});
+      }
+    }
+    return result;
+  }
+
+ private:
+  static const uint32_t STATE_VERSION = 1;
+
+  State state;
+  float latestYield = NAN;
+
+
+  void reset(int32_t day) {
+    state.version = STATE_VERSION;
+    state.today = day;
+    for (float& yield : state.startOfDayYields) {
+      yield = NAN;
+    }
+  }
+
+
+  float& getStartOfDayYield(int32_t day) {
+    return state.startOfDayYields[day % (DAY_COUNT + 1)];
+  }
+
+
+  float getStartOfDayYield(int32_t day) const {
+    return state.startOfDayYields[day % (DAY_COUNT + 1)];
+  }
+};
@@ -0,0 +1,116 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+
+/// Quality of a single value of the photovoltaic data.
+enum class DataQuality : uint8_t {
+  MISSING,  // Not reported at all (NaN).
+  INVALID,  // Outside of the validity range of the field.
+  STALE,  // Valid, but older than the maximum data age.
+  FRESH
+};
+
+
+/// Fields of the photovoltaic data, e.g., as index into PV_FIELD_SPECS.
+enum PVField {
+  PV_FIELD_PAC,
+  PV_FIELD_UAC,
+  PV_FIELD_FREQUENCY,
+  PV_FIELD_TEMPERATURE,
+  PV_FIELD_EFFICIENCY,
+  PV_FIELD_TOTAL_YIELD,
+  PV_FIELD_TODAY_YIELD,
+  PV_FIELD_COUNT
+};
+
+
+/// Validity range of a field. Fields which are not age-relevant (e.g., the
+/// total yield, which stays valid over night) never become stale.
+struct PVFieldSpec {
+  float minValue;
+  float maxValue;
+  bool isAgeRelevant;
+};
+
+
+/// Specification of all fields. A total yield of zero means that the
+/// inverter has not reported yet, hence the minimum above zero.
+const PVFieldSpec PV_FIELD_SPECS[PV_FIELD_COUNT] = {
+  {0.0f, 100000.0f, true},  // P_AC [W]
+  {100.0f, 300.0f, true},  // U_AC [V]
+  {45.0f, 55.0f, true},  // Frequency [Hz]
+  {-40.0f, 120.0f, true},  // Temperature [°C]
+  {0.0f, 100.0f, true},  // Efficiency [%]
+  {0.01f, 1.0e7f, false},  // Total yield [kWh]
+  {0.0f, 1000.0f, false}  // Today's yield [kWh]
+};
+
+
+/// Quality flags of all fields of a data snapshot. The flags are assessed
+/// once per update of the snapshot and published together with it, so that
+/// the consumers (renderer and gauge) only have to look them up.
+class DataQualityFlags {
+ public:
+  DataQualityFlags() {
+    std::fill(flags, flags + PV_FIELD_COUNT, DataQuality::MISSING);
+  }
+
+
+  /// Returns true if the given value is reported and within the validity
+  /// range of the given field.
+  static bool isValidValue(PVField field, float value) {
+    return !std::isnan(value) && PV_FIELD_SPECS[field].minValue <= value && value <= PV_FIELD_SPECS[field].maxValue;
+  }
+
+
+  /// Returns the quality of the given value of the given field with the
+  /// given age.
+  static DataQuality assessValue(PVField field, float value, double ageSeconds, double maxAgeSeconds) {
+    const PVFieldSpec& spec = PV_FIELD_SPECS[field];
+    if (std::isnan(value)) {
+      return DataQuality::MISSING;
+    }
+    if (value < spec.minValue || value > spec.maxValue) {
+      return DataQuality::INVALID;
+    }
+    if (spec.isAgeRelevant && !(ageSeconds < maxAgeSeconds)) {
+      return DataQuality::STALE;
+    }
+    return DataQuality::FRESH;
+  }
+
+
+  void set(PVField field, DataQuality quality) {
+    flags[field] = quality;
+  }
+
+
+  DataQuality get(PVField field) const {
+    return flags[field];
+  }
+
+
+  /// Returns true if the value of the given field is valid and up to date.
+  bool isFresh(PVField field) const {
+    return flags[field] == DataQuality::FRESH;
+  }
+
+
+  /// Returns true if the value of the given field is valid, but possibly stale.
+  bool isValid(PVField field) const {
+    return flags[field] == DataQuality::FRESH || flags[field] == DataQuality::STALE;
+  }
+
+ private:
+  DataQuality flags[PV_FIELD_COUNT];
+};
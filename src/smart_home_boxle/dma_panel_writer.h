@@ -0,0 +1,205 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cstdint>
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <driver/spi_master.h>
+#include <esp_heap_caps.h>
+
+
+/// Writes rows of the black and red planes (e.g., a band or the whole
+/// screen) to a UC8179-based tri-color panel (e.g., GxEPD2_583c_Z83) by DMA
+/// instead of byte by byte. The SPI bus is borrowed from the Arduino SPI
+/// driver used by GxEPD2 once per frame, i.e., from beginFrame to endFrame,
+/// so that all bands of a frame are written with the same SPI device.
+/// GxEPD2 must not access the panel in between. The controller has to be
+/// initialized by GxEPD2 before, e.g., by any writeImage.
+///
+/// The planes are sent in chunks of CHUNK_SIZE bytes with two transactions
+/// in flight, so that the red plane, which has to be inverted for the
+/// controller, is prepared while the previous chunk is transferred.
+class DmaPanelWriter {
+ public:
+  /// Ctor expecting the SPI host (cf. SPI3_HOST for the VSPI pins used by
+  /// the Arduino SPI driver), the pins, and the SPI clock.
+  DmaPanelWriter(spi_host_device_t host, int sckPin, int mosiPin, int csPin, int dcPin, uint32_t clockHz)
+  : host(host), sckPin(sckPin), mosiPin(mosiPin), csPin(csPin), dcPin(dcPin), clockHz(clockHz) {}
+
+  ~DmaPanelWriter() {
+    for (uint32_t* buffer : buffers) {
+      heap_caps_free(buffer);
+    }
+  }
+
+  DmaPanelWriter(const DmaPanelWriter&) = delete;
+  DmaPanelWriter& operator=(const DmaPanelWriter&) = delete;
+
+
+  /// Takes over the SPI bus from the Arduino SPI driver for the writes of
+  /// a frame. Returns false if the SPI bus could not be set up for DMA, in
+  /// which case it is left to the Arduino SPI driver.
+  bool beginFrame() {
+    return (device != nullptr) || acquireBus();
+  }
+
+
+  /// Hands the SPI bus back to the Arduino SPI driver, e.g., before the
+  /// refresh by GxEPD2. Does nothing if the bus is not taken over.
+  void endFrame() {
+    if (device != nullptr) {
+      releaseBus();
+    }
+  }
+
+
+  /// Writes the given rows of the planes (in the layout of GxEPD2, i.e., a
+  /// set bit means white respectively not red) into the partial window of
+  /// these rows, cf. GxEPD2_583c_Z83::writeImage. The pointers point to the
+  /// first row and have to be word-aligned. Returns false if the SPI bus is
+  /// not taken over by beginFrame.
+  bool write(const uint8_t* black, const uint8_t* red, uint16_t rowBytes, uint16_t firstRow, uint16_t rowCount) {
+    if (device == nullptr) {
+      return false;
+    }
+    uint16_t lastColumn = rowBytes * 8 - 1;
+    uint16_t lastRow = firstRow + rowCount - 1;
+    const uint8_t window[] = {0, 0, static_cast<uint8_t>(lastColumn >> 8), static_cast<uint8_t>(lastColumn & 0xFF),
+                              static_cast<uint8_t>(firstRow >> 8), static_cast<uint8_t>(firstRow & 0xFF),
+                              static_cast<uint8_t>(lastRow >> 8), static_cast<uint8_t>(lastRow & 0xFF), 0x01};
+    size_t length = static_cast<size_t>(rowBytes) * rowCount;
+    digitalWrite(csPin, LOW);
+    sendCommand(0x91);  // Partial in.
+    sendCommand(0x90);  // Partial window (horizontal start and end, vertical start and end, scan inside and outside).
+    for (uint8_t value : window) {
+      sendByte(value);
+    }
+    sendCommand(0x10);  // Data start transmission 1 (black/white).
+    sendData(black, length, false);
+    sendCommand(0x13);  // Data start transmission 2 (red), where a set bit means red.
+    sendData(red, length, true);
+    sendCommand(0x92);  // Partial out.
+    digitalWrite(csPin, HIGH);
+    return true;
+  }
+
+ private:
+  static const size_t CHUNK_SIZE = 4092;
+  static const int SLOT_COUNT = 2;
+
+  const spi_host_device_t host;
+  const int sckPin;
+  const int mosiPin;
+  const int csPin;
+  const int dcPin;
+  const uint32_t clockHz;
+  spi_device_handle_t device = nullptr;
+  uint32_t* buffers[SLOT_COUNT] = {nullptr, nullptr};
+  spi_transaction_t transactions[SLOT_COUNT];
+
+
+  /// Takes over the SPI bus from the Arduino SPI driver.
+  bool acquireBus() {
+    for (uint32_t*& buffer : buffers) {
+      if (buffer == nullptr) {
+        buffer = static_cast<uint32_t*>(heap_caps_malloc(CHUNK_SIZE, MALLOC_CAP_DMA));
+        if (buffer == nullptr) {
+          return false;
+        }
+      }
+    }
+
+    SPI.end();
+    spi_bus_config_t busConfig = {};
+    busConfig.mosi_io_num = mosiPin;
+    busConfig.miso_io_num = -1;
+    busConfig.sclk_io_num = sckPin;
+    busConfig.quadwp_io_num = -1;
+    busConfig.quadhd_io_num = -1;
+    busConfig.max_transfer_sz = CHUNK_SIZE;
+    if (spi_bus_initialize(host, &busConfig, SPI_DMA_CH_AUTO) != ESP_OK) {
+      SPI.begin();
+      return false;
+    }
+
+    spi_device_interface_config_t deviceConfig = {};
+    deviceConfig.mode = 0;
+    deviceConfig.clock_speed_hz = clockHz;
+    deviceConfig.spics_io_num = -1;  // CS is held low over all transactions.
+    deviceConfig.queue_size = SLOT_COUNT;
+    if (spi_bus_add_device(host, &deviceConfig, &device) != ESP_OK) {
+      spi_bus_free(host);
+      SPI.begin();
+      return false;
+    }
+    return true;
+  }
+
+
+  /// Hands the SPI bus back to the Arduino SPI driver.
+  void releaseBus() {
+    spi_bus_remove_device(device);
+    device = nullptr;
+    spi_bus_free(host);
+    SPI.begin();
+  }
+
+
+  void sendCommand(uint8_t command) {
+    digitalWrite(dcPin, LOW);
+    sendByte(command);
+    digitalWrite(dcPin, HIGH);
+  }
+
+
+  void sendByte(uint8_t value) {
+    spi_transaction_t transaction = {};
+    transaction.flags = SPI_TRANS_USE_TXDATA;
+    transaction.length = 8;
+    transaction.tx_data[0] = value;
+    spi_device_polling_transmit(device, &transaction);
+  }
+
+
+  /// Sends the given data, optionally inverted, with up to SLOT_COUNT
+  /// transactions in flight. Since the transactions complete in order, a
+  /// slot is free again once the oldest result has been taken.
+  void sendData(const uint8_t* data, size_t length, bool isInverted) {
+    int inFlightCount = 0;
+    int slot = 0;
+    for (size_t offset = 0; offset < length; offset += CHUNK_SIZE) {
+      if (inFlightCount == SLOT_COUNT) {
+        spi_transaction_t* completed;
+        spi_device_get_trans_result(device, &completed, portMAX_DELAY);
+        --inFlightCount;
+      }
+      size_t chunkLength = std::min(CHUNK_SIZE, length - offset);
+      const void* source = data + offset;
+      if (isInverted) {
+        const uint32_t* words = reinterpret_cast<const uint32_t*>(data + offset);
+        for (size_t index = 0; index < (chunkLength + 3) / 4; ++index) {
+          buffers[slot][index] = ~words[index];
+        }
+        source = buffers[slot];
+      }
+      transactions[slot] = {};
+      transactions[slot].length = chunkLength * 8;
+      transactions[slot].tx_buffer = source;
+      spi_device_queue_trans(device, &transactions[slot], portMAX_DELAY);
+      ++inFlightCount;
+      slot = (slot + 1) % SLOT_COUNT;
+    }
+    for (; inFlightCount > 0; --inFlightCount) {
+      spi_transaction_t* completed;
+      spi_device_get_trans_result(device, &completed, portMAX_DELAY);
+    }
+  }
+};
@@ -0,0 +1,398 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <ArduinoJson.h>
+#include <FS.h>
+
+
+/// Replays recorded ThingSpeak feeds with a virtual clock. The recorded feeds
+/// are loaded from streams in the format of the ThingSpeak feeds API (e.g.,
+/// exported by /channels/<id>/feeds.json?start=...&end=...). Requests for
+/// the newest entry and for the medians of a field are answered as
+/// ThingSpeak would do at the virtual time, i.e., the whole processing of
+/// the responses can be run without network at any speed.
+///
+/// To fit recordings of a week or more into the RAM, each value is stored
+/// as 16-bit step within the range of its field in the recorded feed, i.e.,
+/// an entry takes 16 bytes instead of 32 bytes. The quantization error is
+/// at most half a step, i.e., 1/131068 of the range of the field.
+class FeedReplay {
+ public:
+  /// Number of fields per entry, cf. field1 to field6 of the channel.
+  static const int FIELD_COUNT = 6;
+
+
+  /// Loads the recorded feed of the given channel from the given file.
+  /// The entries are parsed one by one so that the whole document never has
+  /// to be kept in memory. The file is read twice, first to determine the
+  /// range of each field, then to store the quantized values. Returns false
+  /// if no entry could be read.
+  bool loadChannel(const String& channelId, File& file) {
+    Feed feed;
+    feed.channelId = channelId;
+    float minValues[FIELD_COUNT];
+    float maxValues[FIELD_COUNT];
+    std::fill(minValues, minValues + FIELD_COUNT, INFINITY);
+    std::fill(maxValues, maxValues + FIELD_COUNT, -INFINITY);
+    size_t entryCount = 0;
+    bool isLoaded = parseEntries(file, [&](time_t, const float* values) {
+      for (int i = 0; i < FIELD_COUNT; ++i) {
+        if (!std::isnan(values[i])) {
+          minValues[i] = std::min(minValues[i], values[i]);
+          maxValues[i] = std::max(maxValues[i], values[i]);
+        }
+      }
+      ++entryCount;
+    });
+    if (!isLoaded || entryCount == 0 || !file.seek(0)) {
+      return false;
+    }
+
+    for (int i = 0; i < FIELD_COUNT; ++i) {
+      feed.scales[i].offset = (minValues[i] <= maxValues[i]) ? minValues[i] : 0.0f;
+      feed.scales[i].step = (minValues[i] < maxValues[i]) ? (maxValues[i] - minValues[i]) / MAX_CODE : 1.0f;
+    }
+    feed.entries.reserve(entryCount);
+    parseEntries(file, [&feed](time_t timestamp, const float* values) {
+      Entry entry;
+      entry.timestamp = static_cast<uint32_t>(timestamp);
+      for (int i = 0; i < FIELD_COUNT; ++i) {
+        entry.codes[i] = feed.scales[i].encode(values[i]);
+      }
+      feed.entries.push_back(entry);
+    });
+
+    std::stable_sort(feed.entries.begin(), feed.entries.end(), [](const Entry& a, const Entry& b) {
+      return a.timestamp < b.timestamp;
+    });
+    feeds.push_back(std::move(feed));
+    return true;
+  }
+
+
+  /// Returns the timestamp of the oldest entry of all channels.
+  time_t getFirstTimestamp() const {
+    time_t result = 0;
+    for (const Feed& feed : feeds) {
+      if (result == 0 || feed.entries.front().timestamp < result) {
+        result = feed.entries.front().timestamp;
+      }
+    }
+    return result;
+  }
+
+
+  /// Returns the timestamp of the newest entry of all channels.
+  time_t getLastTimestamp() const {
+    time_t result = 0;
+    for (const Feed& feed : feeds) {
+      result = std::max(result, static_cast<time_t>(feed.entries.back().timestamp));
+    }
+    return result;
+  }
+
+
+  /// Sets the virtual clock.
+  void setNow(time_t virtualNow) {
+    now = virtualNow;
+  }
+
+
+  /// Returns the virtual clock.
+  time_t getNow() const {
+    return now;
+  }
+
+
+  /// Calls the given function for all recorded values of the given field
+  /// (1 to FIELD_COUNT) of the given channel in time order, regardless of
+  /// the virtual clock, e.g., for backtests.
+  void forEachValue(const String& channelId, int field, const std::function<void(time_t, float)>& function) const {
+    const Feed* feed = getFeed(channelId);
+    if (feed == nullptr || field < 1 || field > FIELD_COUNT) {
+      return;
+    }
+    for (const Entry& entry : feed->entries) {
+      function(entry.timestamp, feed->getValue(entry, field));
+    }
+  }
+
+
+  /// Answers the given ThingSpeak URL at the virtual time. Supported are
+  /// the newest entries (/channels/<id>/feeds.json?results=<n>), the entries
+  /// since a time (/channels/<id>/feeds.json?start=<YYYY-MM-DD%20HH:NN:SS>),
+  /// and the medians of a field (/channels/<id>/fields/<n>.json?median=<m>&minutes=<r>).
+  /// Returns an empty string (like a failed request) for all other URLs.
+  String handleRequest(const String& url) const {
+    int channelStart = url.indexOf("/channels/");
+    if (channelStart < 0) {
+      return String("");
+    }
+    channelStart += strlen("/channels/");
+    int channelEnd = url.indexOf('/', channelStart);
+    const Feed* feed = getFeed(url.substring(channelStart, channelEnd));
+    if (feed == nullptr) {
+      return String("");
+    }
+
+    String path = url.substring(channelEnd);
+    if (path.startsWith("/feeds.json")) {
+      String start = getQueryText(url, "start");
+      if (start.length() > 0) {
+        start.replace("%20", " ");
+        return getEntriesSince(*feed, parseTimestamp(start.c_str(), "%Y-%m-%d %H:%M:%S"));
+      }
+      return getNewestEntries(*feed, getQueryParameter(url, "results"));
+    }
+    if (path.startsWith("/fields/")) {
+      int field = path.substring(strlen("/fields/")).toInt();
+      if (field < 1 || field > FIELD_COUNT) {
+        return String("");
+      }
+      return getFieldMedians(*feed, field, getQueryParameter(url, "median"), getQueryParameter(url, "minutes"));
+    }
+    return String("");
+  }
+
+ private:
+  /// Largest code of a quantized value; the next code marks a missing value.
+  static const uint16_t MAX_CODE = 65534;
+  static const uint16_t MISSING_CODE = 65535;
+
+  struct Entry {
+    uint32_t timestamp;
+    uint16_t codes[FIELD_COUNT];
+  };
+
+  /// Linear quantization of the values of a field.
+  struct FieldScale {
+    float offset;
+    float step;
+
+    uint16_t encode(float value) const {
+      if (std::isnan(value)) {
+        return MISSING_CODE;
+      }
+      float code = std::round((value - offset) / step);
+      return static_cast<uint16_t>(std::min(std::max(code, 0.0f), static_cast<float>(MAX_CODE)));
+    }
+
+    float decode(uint16_t code) const {
+      return (code == MISSING_CODE) ? NAN : offset + step * code;
+    }
+  };
+
+  struct Feed {
+    String channelId;
+    FieldScale scales[FIELD_COUNT];
+    std::vector<Entry> entries;
+
+    float getValue(const Entry& entry, int field) const {
+      return scales[field - 1].decode(entry.codes[field - 1]);
+    }
+  };
+
+  std::vector<Feed> feeds;
+  time_t now = 0;
+
+
+  const Feed* getFeed(const String& channelId) const {
+    for (const Feed& feed : feeds) {
+      if (feed.channelId == channelId) {
+        return &feed;
+      }
+    }
+    return nullptr;
+  }
+
+
+  /// Parses the entries of a recorded feed from the given stream and calls
+  /// the given function for each with its timestamp and the values of the
+  /// fields (NAN if missing). Returns false if the feeds were not found.
+  static bool parseEntries(Stream& stream, const std::function<void(time_t, const float*)>& function) {
+    if (!stream.find("\"feeds\":[")) {
+      return false;
+    }
+    JsonDocument entryDoc;
+    float values[FIELD_COUNT];
+    do {
+      if (deserializeJson(entryDoc, stream) != DeserializationError::Ok) {
+        break;
+      }
+      for (int field = 1; field <= FIELD_COUNT; ++field) {
+        JsonVariant value = entryDoc["field" + String(field)];
+        values[field - 1] = value.isNull() ? NAN : value.as<float>();
+      }
+      function(parseTimestamp(entryDoc["created_at"]), values);
+    } while (stream.findUntil(",", "]"));
+    return true;
+  }
+
+
+  /// Returns the entries not after the virtual time, i.e., the end of the
+  /// visible part of the given entries.
+  std::vector<Entry>::const_iterator getVisibleEnd(const std::vector<Entry>& entries) const {
+    return std::upper_bound(entries.begin(), entries.end(), now, [](time_t timestamp, const Entry& entry) {
+      return timestamp < entry.timestamp;
+    });
+  }
+
+
+  String getNewestEntries(const Feed& feed, int results) const {
+    auto end = getVisibleEnd(feed.entries);
+    auto begin = end - std::min<long>(std::max(results, 1), end - feed.entries.begin());
+    return formatEntries(feed, begin, end);
+  }
+
+
+  String getEntriesSince(const Feed& feed, time_t start) const {
+    auto end = getVisibleEnd(feed.entries);
+    auto begin = std::lower_bound(feed.entries.begin(), end, start, [](const Entry& entry, time_t timestamp) {
+      return entry.timestamp < timestamp;
+    });
+    return formatEntries(feed, begin, end);
+  }
+
+
+  static String formatEntries(const Feed& feed, std::vector<Entry>::const_iterator begin, std::vector<Entry>::const_iterator end) {
+    String json = "{\"feeds\":[";
+    for (auto entry = begin; entry != end; ++entry) {
+      if (entry != begin) {
+        json += ",";
+      }
+      json += "{\"created_at\":\"" + formatTimestamp(entry->timestamp) + "\"";
+      for (int field = 1; field <= FIELD_COUNT; ++field) {
+        json += ",\"field" + String(field) + "\":" + formatValue(feed.getValue(*entry, field));
+      }
+      json += "}";
+    }
+    json += "]}";
+    return json;
+  }
+
+
+  /// Returns the medians of the given field over buckets of the given
+  /// length within the given range before the virtual time. The buckets are
+  /// aligned to multiples of their length and stamped with their start.
+  String getFieldMedians(const Feed& feed, int field, int medianMinutes, int rangeMinutes) const {
+    time_t bucketSeconds = std::max(medianMinutes, 1) * 60L;
+    auto end = getVisibleEnd(feed.entries);
+    auto begin = std::upper_bound(feed.entries.begin(), end, now - rangeMinutes * 60L, [](time_t timestamp, const Entry& entry) {
+      return timestamp < entry.timestamp;
+    });
+
+    String json = "{\"feeds\":[";
+    bool isFirst = true;
+    std::vector<float> values;
+    for (auto entry = begin; entry != end;) {
+      time_t bucketStart = (entry->timestamp / bucketSeconds) * bucketSeconds;
+      values.clear();
+      for (; entry != end && entry->timestamp < bucketStart + bucketSeconds; ++entry) {
+        float value = feed.getValue(*entry, field);
+        if (!std::isnan(value)) {
+          values.push_back(value);
+        }
+      }
+      if (!isFirst) {
+        json += ",";
+      }
+      isFirst = false;
+      json += "{\"created_at\":\"" + formatTimestamp(bucketStart) + "\",\"field" + String(field) + "\":" + formatValue(getMedian(values)) + "}";
+    }
+    json += "]}";
+    return json;
+  }
+
+
+  static float getMedian(std::vector<float>& values) {
+    if (values.empty()) {
+      return NAN;
+    }
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    if (values.size() % 2 == 1) {
+      return values[middle];
+    }
+    float upper = values[middle];
+    float lower = *std::max_element(values.begin(), values.begin() + middle);
+    return (lower + upper) / 2.0f;
+  }
+
+
+  static int getQueryParameter(const String& url, const char* name) {
+    return getQueryText(url, name).toInt();
+  }
+
+
+  /// Returns the (still URL-encoded) value of the given query parameter, or
+  /// an empty string if it is missing.
+  static String getQueryText(const String& url, const char* name) {
+    String key = String(name) + "=";
+    int start = url.indexOf("?" + key);
+    if (start < 0) {
+      start = url.indexOf("&" + key);
+    }
+    if (start < 0) {
+      return String("");
+    }
+    start += 1 + key.length();
+    int end = url.indexOf('&', start);
+    return (end < 0) ? url.substring(start) : url.substring(start, end);
+  }
+
+
+  /// Parses the given UTC timestamp. Unlike mktime, the conversion does
+  /// not depend on the time zone of the system.
+  static time_t parseTimestamp(const char* text, const char* format = "%Y-%m-%dT%H:%M:%SZ") {
+    tm timestamp = {};
+    if (text != nullptr) {
+      strptime(text, format, &timestamp);
+    }
+    return toEpochSeconds(timestamp);
+  }
+
+
+  /// Converts the given broken-down UTC time into seconds since epoch like
+  /// the non-standard timegm, which is not available on all platforms. The
+  /// days are counted by the algorithm days_from_civil of H. Hinnant.
+  static time_t toEpochSeconds(const tm& time) {
+    long year = time.tm_year + 1900L - ((time.tm_mon < 2) ? 1 : 0);
+    long era = ((year >= 0) ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long month = time.tm_mon + 1;
+    long dayOfYear = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + time.tm_mday - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    long days = era * 146097L + dayOfEra - 719468L;
+    return static_cast<time_t>(days) * 86400 + time.tm_hour * 3600L + time.tm_min * 60L + time.tm_sec;
+  }
+
+
+  static String formatTimestamp(time_t timestamp) {
+    tm time;
+    gmtime_r(&timestamp, &time);
+    char text[24];
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &time);
+    return String(text);
+  }
+
+
+  /// Formats the given value as string like ThingSpeak does, or as null if
+  /// the value is missing.
+  static String formatValue(float value) {
+    return std::isnan(value) ? String("null") : "\"" + String(value, 3) + "\"";
+  }
+};
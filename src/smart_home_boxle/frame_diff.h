@@ -0,0 +1,75 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cstdint>
+
+
+/// Compares a bit plane of a frame (cf. TriColorFrameBuffer) with the one of
+/// a golden frame. The planes may be passed in chunks so that the golden
+/// frame can be streamed from a file. The result is the number of
+/// different pixels and their bounding box in physical coordinates.
+class FrameDiff {
+ public:
+  /// Ctor expecting the physical width of the frame.
+  explicit FrameDiff(int physicalWidth)
+  : physicalWidth(physicalWidth) {}
+
+
+  /// Compares the given chunks of the actual and the expected plane, both
+  /// starting at the given byte offset within the plane.
+  void addChunk(const uint8_t* actual, const uint8_t* expected, uint32_t offset, uint32_t length) {
+    for (uint32_t index = 0; index < length; ++index) {
+      uint8_t difference = actual[index] ^ expected[index];
+      if (difference == 0) {
+        continue;
+      }
+      differentPixelCount += __builtin_popcount(difference);
+      // The leftmost pixel is in the most significant bit.
+      uint32_t firstBit = (offset + index) * 8 + __builtin_clz(difference) - 24;
+      uint32_t lastBit = (offset + index) * 8 + 7 - __builtin_ctz(difference);
+      addToBoundingBox(firstBit);
+      addToBoundingBox(lastBit);
+    }
+  }
+
+
+  /// Returns the number of different pixels.
+  uint32_t getDifferentPixelCount() const {
+    return differentPixelCount;
+  }
+
+
+  /// Returns the bounding box [x0, x1] x [y0, y1] of all different pixels.
+  /// Only valid if there is at least one different pixel.
+  void getBoundingBox(int& x0, int& y0, int& x1, int& y1) const {
+    x0 = minX;
+    y0 = minY;
+    x1 = maxX;
+    y1 = maxY;
+  }
+
+ private:
+  const int physicalWidth;
+  uint32_t differentPixelCount = 0;
+  int minX = INT16_MAX;
+  int minY = INT16_MAX;
+  int maxX = -1;
+  int maxY = -1;
+
+
+  void addToBoundingBox(uint32_t bit) {
+    int x = bit % physicalWidth;
+    int y = bit / physicalWidth;
+    minX = std::min(minX, x);
+    minY = std::min(minY, y);
+    maxX = std::max(maxX, x);
+    maxY = std::max(maxY, y);
+  }
+};
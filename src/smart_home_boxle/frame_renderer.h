@@ -0,0 +1,486 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include <U8g2_for_Adafruit_GFX.h>
+#include <Fonts/FreeSans9pt7b.h>
+#include <Fonts/FreeSans12pt7b.h>
+#include <Fonts/FreeSansBold24pt7b.h>
+
+#include "anomaly_detector.h"
+#include "clear_sky_model.h"
+#include "daily_yield.h"
+#include "data_quality.h"
+#include "plot_utility.h"
+#include "pv_data.h"
+#include "time_ticks.h"
+#include "tri_color_frame_buffer.h"
+
+
+const int MAX_ZOOM = 6;
+const std::array<int, MAX_ZOOM + 1> ZOOM_TO_RESOLUTION_MINUTES{ 10,   20,       30,       60,       60,       240,       720};
+const std::array<int, MAX_ZOOM + 1> ZOOM_TO_RANGE_MINUTES{     720, 1440, 2 * 1440, 4 * 1440, 8 * 1440, 16 * 1440, 32 * 1440};
+
+// From this zoom level on, the medians of ThingSpeak hide the peaks of P_AC.
+// Hence, P_AC is queried at a finer resolution, aggregated per pixel column
+// into minimum, median, and maximum, and drawn as envelope with median line.
+const int PAC_ENVELOPE_MIN_ZOOM = 4;
+const std::array<int, MAX_ZOOM + 1> ZOOM_TO_PAC_ENVELOPE_RESOLUTION_MINUTES{0, 0, 0, 0, 15, 30, 60};
+const uint8_t PAC_ENVELOPE_DITHER_LEVEL = 8;
+
+// Draw the P_AC curve as area chart (dithered red fill with black outline)
+// instead of markers connected by lines. The dither level ranges from 0
+// (no fill) to 16 (solid fill).
+// With several channels, the areas are stacked with one dither level per
+// channel.
+const bool PAC_PLOT_AS_AREA = true;
+const std::array<uint8_t, 4> PAC_AREA_DITHER_LEVELS{6, 16, 2, 11};
+
+// Curves are interrupted where consecutive samples are further apart than
+// this number of resolution steps of the current zoom level.
+const double MAX_GAP_IN_RESOLUTION_STEPS = 2.5;
+
+const int PAC_PLOT_WIDTH = 360 - 15 - 40;
+
+const int GAUGE_INDICATOR_WIDTH = 240;
+const int GAUGE_INDICATOR_HEIGHT = 28;
+
+// Sources of the logged anomaly events, i.e., the monitored grid quantities.
+enum AnomalySource : uint8_t {
+  ANOMALY_SOURCE_FREQUENCY,
+  ANOMALY_SOURCE_UAC
+};
+
+
+/// Returns the resolution at which the P_AC curve is queried for the given
+/// zoom level.
+inline int getPACResolutionMinutes(int zoom) {
+  return (zoom >= PAC_ENVELOPE_MIN_ZOOM) ? ZOOM_TO_PAC_ENVELOPE_RESOLUTION_MINUTES[zoom] : ZOOM_TO_RESOLUTION_MINUTES[zoom];
+}
+
+
+/// Data shown on the e-Ink display, collected from all channels. The curves
+/// have the timestamps (seconds since epoch) as x values.
+struct FrameData {
+  tm currentTime = {};  // UTC.
+  time_t now = 0;
+  int zoom = 3;
+  PVSingleData newestData;  // Combined over all channels.
+  std::vector<PVSingleData> channelData;  // Newest data of each channel.
+  std::vector<std::vector<PlotPoint>> pacCurves;  // One per channel.
+  std::vector<PlotPoint> uacCurve;
+  std::vector<PlotPoint> frequencyCurve;
+  std::vector<PlotPoint> dailyYields;  // Cf. DailyYieldHistory::getDailyYields.
+  const AnomalyEventLog* anomalyLog = nullptr;
+  const ClearSkyModel* clearSkyModel = nullptr;
+  double pacPlotMaxWatts = NAN;  // NaN to scale the P_AC axis to the data.
+  double pacReferenceWatts = NAN;
+  String gaugeModeLabel;
+};
+
+
+/// Renders the whole screen of the e-Ink display from the given FrameData.
+/// The curves are prepared (split at gaps, stacked, scaled, etc.) once per
+/// frame by prepare(). Then render() draws the frame, which is called once
+/// per page (i.e., band) of the display. The renderer does not depend on
+/// the panel, so that the frames can also be rendered on a host.
+class FrameRenderer {
+ public:
+  FrameRenderer()
+  : timeTickGenerator(4) {}
+
+
+  /// Prepares the given data for the drawing.
+  void prepare(const FrameData& data) {
+    currentTime = data.currentTime;
+    zoom = data.zoom;
+    newestData = data.newestData;
+    channelData = data.channelData;
+    dailyYields = data.dailyYields;
+    pacReferenceWatts = data.pacReferenceWatts;
+    gaugeModeLabel = data.gaugeModeLabel;
+
+    // Split the curves at missing samples and at gaps (e.g., inverter
+    // offline over night) once, so that the drawing does not have to check
+    // each point. The P_AC curves of all channels are stacked, i.e.,
+    // pacStack[k] is the sum of the channels 0 to k.
+    double maxGapSeconds = MAX_GAP_IN_RESOLUTION_STEPS * ZOOM_TO_RESOLUTION_MINUTES[zoom] * 60;
+    double maxPACGapSeconds = MAX_GAP_IN_RESOLUTION_STEPS * getPACResolutionMinutes(zoom) * 60;
+    pacStack.clear();
+    for (const std::vector<PlotPoint>& curve : data.pacCurves) {
+      std::vector<PlotSegment> segments = PlotUtility::splitIntoSegments(toRelativeTime(curve, data.now), maxPACGapSeconds);
+      if (!pacStack.empty()) {
+        segments = PlotUtility::splitIntoSegments(PlotUtility::addSeries(pacStack.back(), segments), maxPACGapSeconds);
+      }
+      pacStack.push_back(segments);
+    }
+    if (pacStack.empty()) {
+      pacStack.push_back(std::vector<PlotSegment>());
+    }
+    uacCurve = PlotUtility::splitIntoSegments(toRelativeTime(data.uacCurve, data.now), maxGapSeconds);
+    frequencyCurve = PlotUtility::splitIntoSegments(toRelativeTime(data.frequencyCurve, data.now), maxGapSeconds);
+
+    // Clear-sky reference with about one point per pixel column of the P_AC
+    // plot, but at least one per slot of the model.
+    clearSkyCurve.clear();
+    long rangeSeconds = getRangeSeconds();
+    if (data.clearSkyModel != nullptr) {
+      long clearSkyStepSeconds = std::max<long>(ClearSkyModel::SECONDS_PER_DAY / ClearSkyModel::SLOT_COUNT, rangeSeconds / PAC_PLOT_WIDTH);
+      for (long offset = -rangeSeconds; offset <= 0; offset += clearSkyStepSeconds) {
+        clearSkyCurve.push_back({static_cast<double>(offset), data.clearSkyModel->getExpectedWatts(data.now + offset)});
+      }
+    }
+
+    // The y axes are scaled to the data. Only P_AC is fixed at 0 W as lower
+    // limit. The minimum spans avoid zooming into noise.
+    std::vector<PlotSegment> pacAxisCurves = pacStack.back();
+    pacAxisCurves.push_back(clearSkyCurve);
+    pacAxis = PlotUtility::computeNiceYAxis(pacAxisCurves, 0.0, data.pacPlotMaxWatts, 100.0, 5);
+    uacAxis = PlotUtility::computeNiceYAxis(uacCurve, NAN, NAN, 20.0, 3);
+    frequencyAxis = PlotUtility::computeNiceYAxis(frequencyCurve, NAN, NAN, 0.2, 3);
+    yieldAxis = PlotUtility::computeNiceYAxis({dailyYields}, 0.0, NAN, 1.0, 2);
+    uacAnomalies = getAnomalyPoints(data.anomalyLog, ANOMALY_SOURCE_UAC, data.now, uacAxis);
+    frequencyAnomalies = getAnomalyPoints(data.anomalyLog, ANOMALY_SOURCE_FREQUENCY, data.now, frequencyAxis);
+
+    xTicks = timeTickGenerator.getTicks(rangeSeconds, data.now);
+
+    pacEnvelope.clear();
+    if (zoom >= PAC_ENVELOPE_MIN_ZOOM) {
+      PlotUtility pacPlot = createPACPlot();
+      for (const PlotSegment& segment : pacStack.back()) {
+        pacEnvelope.push_back(pacPlot.aggregateIntoColumns(segment));
+      }
+    }
+  }
+
+
+  /// Draws the prepared frame into the given frame buffer. The whole
+  /// screen is drawn, i.e., the previous content is cleared.
+  void render(TriColorFrameBuffer& display, U8G2_FOR_ADAFRUIT_GFX& u8g2Fonts) const {
+    const uint16_t BLACK = TriColorFrameBuffer::BLACK;
+    const uint16_t RED = TriColorFrameBuffer::RED;
+    const uint16_t WHITE = TriColorFrameBuffer::WHITE;
+    TriColorFrameBuffer* displayPtr = &display;
+
+    display.setRotation(2);
+    display.setTextColor(BLACK);
+    u8g2Fonts.setForegroundColor(BLACK);
+    u8g2Fonts.setBackgroundColor(WHITE);
+    display.fillScreen(WHITE);
+
+    // Current P_AC.
+    if (newestData.quality.isFresh(PV_FIELD_PAC)) {
+      u8g2Fonts.setFont(u8g2_font_logisoso92_tn);
+      String currentPAC = String(newestData.pAC, 0);
+      int16_t textWidth = u8g2Fonts.getUTF8Width(currentPAC.c_str());
+      u8g2Fonts.setCursor(200 - 20 - textWidth, 156);
+      u8g2Fonts.print(currentPAC);
+      display.setFont(&FreeSansBold24pt7b);
+      display.setCursor(200, 156);
+      display.print("Watt");
+    } else {
+      display.setFont(&FreeSansBold24pt7b);
+      display.setCursor(0, 156);
+      display.print("Kein Ertrag!");
+    }
+
+    drawGaugeModeIndicator(display, gaugeModeLabel);
+
+    // Current time.
+    display.setFont(&FreeSans12pt7b);
+    char stringBuffer[50];
+    strftime(stringBuffer, sizeof(stringBuffer), "%H:%M", &currentTime);
+    String timeString = stringBuffer + String(" (UTC)");
+    display.setCursor(635 - getTextWidth(display, timeString), 21);
+    display.print(timeString);
+
+    // Other current values
+    display.setFont(&FreeSans12pt7b);
+    String currentUAC = "Netzspannung: -";
+    String currentFrequency = "Frequenz: -";
+    String currentTemperature = "Temperatur: -";
+    String currentEfficiency = "Effizienz: -";
+    String totalYield = "Gesamtertrag: -";
+    if (newestData.quality.isFresh(PV_FIELD_UAC)) {
+      currentUAC = "Netzspannung: " + String(newestData.uAC, 1) + " V";
+    }
+    if (newestData.quality.isFresh(PV_FIELD_FREQUENCY)) {
+      currentFrequency = "Frequenz: " + String(newestData.frequency, 2) + " Hz";
+    }
+    if (newestData.quality.isFresh(PV_FIELD_TEMPERATURE)) {
+      currentTemperature = "Temperatur: " + String(newestData.temperature, 1) + " C";
+    }
+    if (newestData.quality.isFresh(PV_FIELD_EFFICIENCY)) {
+      currentEfficiency = "Effizienz: " + String(newestData.efficiency, 1) + " %";
+    }
+    if (newestData.quality.isValid(PV_FIELD_TOTAL_YIELD)) {
+      totalYield = "Gesamtertrag: " + String(newestData.totalYield, 1) + " kWh";
+    }
+    display.setCursor(360, 60);
+    display.print(currentUAC);
+    display.setCursor(360, 92);
+    display.print(currentFrequency);
+    display.setCursor(360, 124);
+    display.print(currentTemperature);
+    display.setCursor(360, 156);
+    display.print(currentEfficiency);
+    display.setCursor(360, 188);
+    display.print(totalYield);
+
+    // Daily yields of the last days with today in red.
+    PlotUtility yieldPlot(40, 172, 360 - 15 - 40, 36, -DailyYieldHistory::DAY_COUNT + 0.5, 0.5, yieldAxis.min, yieldAxis.max);
+    yieldPlot.setYTicks(yieldAxis.ticks);
+
+    yieldPlot.drawBars(dailyYields, 15, [displayPtr](int x, int y, int w, int h, PlotPoint point) {
+      displayPtr->fillRect(x, y, w, h, (point.x == 0.0) ? RED : BLACK);
+    });
+
+    yieldPlot.drawXAxis([displayPtr](int x0, int y0, int x1, int y1) {
+      displayPtr->drawLine(x0, y0, x1, y1, BLACK);
+    });
+
+    yieldPlot.drawYTicks([displayPtr](int x, int y, double relativePosition, String label) {
+      displayPtr->setFont(&FreeSans9pt7b);
+      displayPtr->setCursor(40 - 4 - getTextWidth(*displayPtr, label), y + 5);
+      displayPtr->print(label.c_str());
+    });
+
+    PlotUtility pacPlot = createPACPlot();
+    const std::vector<PlotSegment>& pacCurve = pacStack.back();
+
+    if (pacPlot.isYValueInRange(pacReferenceWatts)) {
+      int y = pacPlot.getYPixelForYValue(pacReferenceWatts);
+      display.drawLine(40, y, 360 - 15, y, RED);
+    }
+
+    drawAxesAndTicks(display, pacPlot, 40);
+
+    if (!pacEnvelope.empty()) {
+      for (const std::vector<PlotBucket>& buckets : pacEnvelope) {
+        pacPlot.drawEnvelope(buckets, [displayPtr](int x, int yMax, int yMin) {
+          displayPtr->drawDitheredFastVLine(x, yMax, yMin - yMax + 1, RED, PAC_ENVELOPE_DITHER_LEVEL);
+        });
+        pacPlot.drawLinesBetweenPoints(PlotUtility::getMedians(buckets), [displayPtr](int x0, int y0, int x1, int y1, PlotPoint point0, PlotPoint point1) {
+          displayPtr->drawLine(x0, y0, x1, y1, BLACK);
+        });
+      }
+    } else if (PAC_PLOT_AS_AREA) {
+      // Draw the stacked areas from the top (i.e., the sum of all channels)
+      // to the bottom, each one clearing the ones above.
+      for (size_t index = pacStack.size(); index-- > 0;) {
+        uint8_t ditherLevel = PAC_AREA_DITHER_LEVELS[index % PAC_AREA_DITHER_LEVELS.size()];
+        bool isCovering = (index + 1 < pacStack.size());
+        pacPlot.drawAreaUnderPoints(pacStack[index], [displayPtr, ditherLevel, isCovering](int x, int yTop, int yBottom) {
+          // Without rows between the top and the bottom, a line of height
+          // zero or below would be normalized by Adafruit_GFX to a pixel
+          // on or below the x axis.
+          if (yBottom - yTop >= 2) {
+            if (isCovering) {
+              displayPtr->drawFastVLine(x, yTop + 1, yBottom - yTop - 1, WHITE);
+            }
+            displayPtr->drawDitheredFastVLine(x, yTop + 1, yBottom - yTop - 1, RED, ditherLevel);
+          }
+          displayPtr->drawPixel(x, yTop, BLACK);
+        });
+      }
+
+      // Legend with the current P_AC of each channel.
+      if (channelData.size() > 1) {
+        display.setFont(&FreeSans9pt7b);
+        for (size_t index = 0; index < channelData.size(); ++index) {
+          int y = 235 + 4 + 16 * index;
+          for (int x = 45; x < 55; ++x) {
+            display.drawDitheredFastVLine(x, y, 10, RED, PAC_AREA_DITHER_LEVELS[index % PAC_AREA_DITHER_LEVELS.size()]);
+          }
+          display.drawRect(45, y, 10, 10, BLACK);
+          display.setCursor(59, y + 10);
+          const PVSingleData& data = channelData[index];
+          display.print(data.quality.isFresh(PV_FIELD_PAC) ? String(data.pAC, 0) + " W" : String("- W"));
+        }
+      }
+    } else {
+      pacPlot.drawPoints(pacCurve, [displayPtr](int x, int y, PlotPoint point) {
+        displayPtr->stampMarker(x, y, 3, BLACK);
+      });
+
+      pacPlot.drawLinesBetweenPoints(pacCurve, [displayPtr](int x0, int y0, int x1, int y1, PlotPoint point0, PlotPoint point1) {
+        displayPtr->drawLine(x0, y0, x1, y1, BLACK);
+      });
+    }
+
+    pacPlot.drawReferenceSeries(clearSkyCurve, 4, [displayPtr](int x, int y) {
+      displayPtr->fillRect(x, y - 1, 2, 2, BLACK);
+    });
+
+    PlotUtility uacPlot(360 + 35, 235, 635 - (360 + 35), 86, -getRangeSeconds(), 0, uacAxis.min, uacAxis.max);
+    uacPlot.setXTicks(xTicks);
+    uacPlot.setYTicks(uacAxis.ticks);
+    drawGridPlot(display, uacPlot, 230.0, uacCurve, uacAnomalies);
+
+    PlotUtility frequencyPlot(360 + 35, 235 + 208 - 86, 635 - (360 + 35), 86, -getRangeSeconds(), 0, frequencyAxis.min, frequencyAxis.max);
+    frequencyPlot.setXTicks(xTicks);
+    frequencyPlot.setYTicks(frequencyAxis.ticks);
+    drawGridPlot(display, frequencyPlot, 50.0, frequencyCurve, frequencyAnomalies);
+  }
+
+
+  /// Draws the indicator of the gauge mode with the given label into the
+  /// given frame buffer.
+  static void drawGaugeModeIndicator(TriColorFrameBuffer& display, const String& label) {
+    display.fillRect(0, 0, GAUGE_INDICATOR_WIDTH, GAUGE_INDICATOR_HEIGHT, TriColorFrameBuffer::WHITE);
+    display.setFont(&FreeSans12pt7b);
+    display.setCursor(0, 21);
+    display.print("Zeiger: " + label);
+  }
+
+ private:
+  TimeTickGenerator timeTickGenerator;  // Cached between the frames.
+  tm currentTime = {};
+  int zoom = 3;
+  PVSingleData newestData;
+  std::vector<PVSingleData> channelData;
+  std::vector<PlotPoint> dailyYields;
+  double pacReferenceWatts = NAN;
+  String gaugeModeLabel;
+  std::vector<std::vector<PlotSegment>> pacStack;
+  std::vector<PlotSegment> uacCurve;
+  std::vector<PlotSegment> frequencyCurve;
+  PlotSegment clearSkyCurve;
+  PlotAxis pacAxis;
+  PlotAxis uacAxis;
+  PlotAxis frequencyAxis;
+  PlotAxis yieldAxis;
+  std::vector<PlotPoint> uacAnomalies;
+  std::vector<PlotPoint> frequencyAnomalies;
+  std::vector<PlotTick> xTicks;
+  std::vector<std::vector<PlotBucket>> pacEnvelope;
+
+
+  long getRangeSeconds() const {
+    return ZOOM_TO_RANGE_MINUTES[zoom] * 60L;
+  }
+
+
+  PlotUtility createPACPlot() const {
+    PlotUtility pacPlot(40, 235, PAC_PLOT_WIDTH, 208, -getRangeSeconds(), 0, pacAxis.min, pacAxis.max);
+    pacPlot.setXTicks(xTicks);
+    pacPlot.setYTicks(pacAxis.ticks);
+    return pacPlot;
+  }
+
+
+  /// Converts the given curve with timestamps as x values into a curve with
+  /// times relative to now and drops all points outside of the range of the
+  /// current zoom level.
+  std::vector<PlotPoint> toRelativeTime(const std::vector<PlotPoint>& curve, time_t now) const {
+    std::vector<PlotPoint> result;
+    result.reserve(curve.size());
+    for (const PlotPoint& point : curve) {
+      double relativeTime = point.x - static_cast<double>(now);
+      if (-getRangeSeconds() <= relativeTime && relativeTime <= 0.0) {
+        result.push_back({relativeTime, point.y});
+      }
+    }
+    return result;
+  }
+
+
+  /// Returns the logged anomalies of the given source in the range of the
+  /// current zoom level as points relative to now. The values are limited
+  /// to the given axis so that the markers of far-off values are drawn at
+  /// the border of the plot.
+  std::vector<PlotPoint> getAnomalyPoints(const AnomalyEventLog* anomalyLog, AnomalySource source, time_t now, const PlotAxis& axis) const {
+    std::vector<PlotPoint> result;
+    if (anomalyLog == nullptr) {
+      return result;
+    }
+    for (const AnomalyEvent& event : anomalyLog->getEvents(source, static_cast<uint32_t>(std::max<time_t>(now - getRangeSeconds(), 0)))) {
+      double relativeTime = static_cast<double>(event.timestamp) - static_cast<double>(now);
+      if (relativeTime <= 0.0) {
+        result.push_back({relativeTime, std::min(std::max(static_cast<double>(event.value), axis.min), axis.max)});
+      }
+    }
+    return result;
+  }
+
+
+  /// Draws the axes of the given plot with their ticks and labels. The
+  /// labels of the y axis are right-aligned to the given x position.
+  static void drawAxesAndTicks(TriColorFrameBuffer& display, PlotUtility& plot, int yLabelRight) {
+    const uint16_t BLACK = TriColorFrameBuffer::BLACK;
+    TriColorFrameBuffer* displayPtr = &display;
+
+    plot.drawXAxis([displayPtr](int x0, int y0, int x1, int y1) {
+      displayPtr->drawLine(x0, y0, x1, y1, BLACK);
+    });
+
+    plot.drawYAxis([displayPtr](int x0, int y0, int x1, int y1) {
+      displayPtr->drawLine(x0, y0, x1, y1, BLACK);
+    });
+
+    plot.drawXTicks([displayPtr](int x, int y, double relativePosition, String label) {
+      displayPtr->drawLine(x, y, x, y + 2, BLACK);
+      displayPtr->setFont(&FreeSans9pt7b);
+      displayPtr->setCursor(x - static_cast<int>(relativePosition * getTextWidth(*displayPtr, label)), y + 18);
+      displayPtr->print(label.c_str());
+    });
+
+    plot.drawYTicks([displayPtr, yLabelRight](int x, int y, double relativePosition, String label) {
+      displayPtr->drawLine(x - 2, y, x, y, BLACK);
+      displayPtr->setFont(&FreeSans9pt7b);
+      displayPtr->setCursor(yLabelRight - 4 - getTextWidth(*displayPtr, label), y + 5);
+      displayPtr->print(label.c_str());
+    });
+  }
+
+
+  /// Draws a plot of a grid quantity (U_AC or frequency) with its nominal
+  /// value as red line, the curve as markers connected by lines, and the
+  /// anomalies as large red markers.
+  static void drawGridPlot(TriColorFrameBuffer& display, PlotUtility& plot, double nominalValue,
+                           const std::vector<PlotSegment>& curve, const std::vector<PlotPoint>& anomalies) {
+    const uint16_t BLACK = TriColorFrameBuffer::BLACK;
+    const uint16_t RED = TriColorFrameBuffer::RED;
+    TriColorFrameBuffer* displayPtr = &display;
+
+    if (plot.isYValueInRange(nominalValue)) {
+      int y = plot.getYPixelForYValue(nominalValue);
+      display.drawLine(360 + 35, y, 635, y, RED);
+    }
+
+    drawAxesAndTicks(display, plot, 360 + 35);
+
+    plot.drawPoints(curve, [displayPtr](int x, int y, PlotPoint point) {
+      displayPtr->stampMarker(x, y, 3, BLACK);
+    });
+
+    plot.drawLinesBetweenPoints(curve, [displayPtr](int x0, int y0, int x1, int y1, PlotPoint point0, PlotPoint point1) {
+      displayPtr->drawLine(x0, y0, x1, y1, BLACK);
+    });
+
+    plot.drawPoints(anomalies, [displayPtr](int x, int y, PlotPoint point) {
+      displayPtr->stampMarker(x, y, 5, RED);
+    });
+  }
+
+
+  /// Returns the width of the given text in pixels in the current font.
+  static uint16_t getTextWidth(TriColorFrameBuffer& display, const String& text) {
+    int16_t x, y;
+    uint16_t width, height;
+    display.getTextBounds(text, 0, 0, &x, &y, &width, &height);
+    return width;
+  }
+};
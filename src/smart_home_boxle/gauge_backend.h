@@ -0,0 +1,237 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+#include <esp_timer.h>
+
+#include "motion_profile.h"
+
+
+/// Interface of the backends driving the needle of the gauge (i.e., the
+/// ammeter). The position ranges from 0 (left end) to 1 (full scale).
+/// update() is called periodically and must not block.
+class GaugeBackend {
+ public:
+  virtual ~GaugeBackend() {}
+
+  virtual void begin() = 0;
+
+  virtual void setTarget(float position) = 0;
+
+  virtual void update(unsigned long nowMicros) = 0;
+
+  /// Returns the current (tracked) position of the needle.
+  virtual float getPosition() const = 0;
+};
+
+
+/// Backend for a moving-coil meter driven by PWM, which follows the output
+/// by its own mechanical inertia.
+class PwmGauge : public GaugeBackend {
+ public:
+  explicit PwmGauge(int pin)
+  : pin(pin) {}
+
+  void begin() override {
+    pinMode(pin, OUTPUT);
+    analogWrite(pin, 0);
+  }
+
+  void setTarget(float position) override {
+    target = std::min(std::max(position, 0.0f), 1.0f);
+  }
+
+  void update(unsigned long nowMicros) override {
+    int value = static_cast<int>(255.0f * target + 0.5f);
+    if (value != lastValue) {
+      analogWrite(pin, value);
+      lastValue = value;
+    }
+  }
+
+  float getPosition() const override {
+    return target;
+  }
+
+ private:
+  const int pin;
+  float target = 0.0f;
+  int lastValue = -1;
+};
+
+
+/// Base class of the backends for motors, which move the needle along a
+/// trapezoidal motion profile.
+class MotorGauge : public GaugeBackend {
+ public:
+  explicit MotorGauge(const MotionProfile& profile)
+  : profile(profile) {}
+
+  void setTarget(float position) override {
+    profile.setTarget(position);
+  }
+
+  float getPosition() const override {
+    return profile.getPosition();
+  }
+
+ protected:
+  MotionProfile profile;
+  unsigned long lastUpdateMicros = 0;
+  bool isFirstUpdate = true;
+
+
+  /// Advances the profile to the given time and returns the new position.
+  float advanceProfile(unsigned long nowMicros) {
+    float dtSeconds = isFirstUpdate ? 0.0f : (nowMicros - lastUpdateMicros) * 1e-6f;
+    isFirstUpdate = false;
+    lastUpdateMicros = nowMicros;
+    return profile.update(dtSeconds);
+  }
+};
+
+
+/// Backend for a hobby servo, e.g., of the library ESP32Servo. The servo
+/// stays attached while moving and is detached after it has rested for
+/// IDLE_DETACH_MICROS, which avoids the humming of a servo holding its
+/// position.
+template <typename Servo>
+class ServoGauge : public MotorGauge {
+ public:
+  /// Ctor expecting the pin, the angles at zero and full scale, and the
+  /// motion profile.
+  ServoGauge(int pin, int zeroAngle, int fullScaleAngle, const MotionProfile& profile)
+  : MotorGauge(profile), pin(pin), zeroAngle(zeroAngle), fullScaleAngle(fullScaleAngle) {}
+
+  void begin() override {}
+
+  void update(unsigned long nowMicros) override {
+    float position = advanceProfile(nowMicros);
+    int angle = static_cast<int>(zeroAngle + (fullScaleAngle - zeroAngle) * position + 0.5f);
+    if (angle != lastAngle) {
+      if (!servo.attached()) {
+        servo.attach(pin);
+      }
+      servo.write(angle);
+      lastAngle = angle;
+      lastMoveMicros = nowMicros;
+    } else if (servo.attached() && nowMicros - lastMoveMicros > IDLE_DETACH_MICROS) {
+      servo.detach();
+    }
+  }
+
+ private:
+  static const unsigned long IDLE_DETACH_MICROS = 500000;
+
+  Servo servo;
+  const int pin;
+  const int zeroAngle;
+  const int fullScaleAngle;
+  int lastAngle = -1;
+  unsigned long lastMoveMicros = 0;
+};
+
+
+/// Backend for a stepper motor with a step/direction driver. The position
+/// is tracked in steps, starting at zero (e.g., after homing against the
+/// left end stop). update() only sets the target step and the step interval:
+/// The steps to the new position of the profile are spread evenly over the
+/// update period and emitted one by one by an esp_timer, so that the step
+/// rate follows the profile and each step gets its full period. A change of
+/// the direction takes one interval of its own before the next step (setup
+/// time of the driver).
+class StepperGauge : public MotorGauge {
+ public:
+  /// Ctor expecting the pins, the number of steps for full scale, and the
+  /// motion profile.
+  StepperGauge(int stepPin, int directionPin, int32_t fullScaleSteps, const MotionProfile& profile)
+  : MotorGauge(profile), stepPin(stepPin), directionPin(directionPin), fullScaleSteps(fullScaleSteps) {}
+
+  void begin() override {
+    pinMode(stepPin, OUTPUT);
+    pinMode(directionPin, OUTPUT);
+    digitalWrite(stepPin, LOW);
+    digitalWrite(directionPin, HIGH);
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = &StepperGauge::onStepTimer;
+    timerArgs.arg = this;
+    timerArgs.name = "stepper";
+    esp_timer_create(&timerArgs, &stepTimer);
+  }
+
+  void update(unsigned long nowMicros) override {
+    unsigned long periodMicros = isFirstUpdate ? 0 : nowMicros - lastUpdateMicros;
+    float position = advanceProfile(nowMicros);
+    int32_t newTargetStep = static_cast<int32_t>(std::lround(position * fullScaleSteps));
+    targetStep.store(newTargetStep);
+    uint32_t stepCount = static_cast<uint32_t>(std::abs(newTargetStep - currentStep.load()));
+    if (stepCount == 0 || stepTimer == nullptr) {
+      return;
+    }
+    uint32_t intervalMicros = periodMicros / stepCount;
+    stepIntervalMicros.store((intervalMicros > MIN_STEP_INTERVAL_MICROS) ? intervalMicros : MIN_STEP_INTERVAL_MICROS);
+    // If the timer has stopped just after this check, the next update
+    // restarts it.
+    if (!isStepping.exchange(true)) {
+      esp_timer_start_once(stepTimer, stepIntervalMicros.load());
+    }
+  }
+
+  /// Returns the position of the needle according to the emitted steps.
+  float getPosition() const override {
+    return static_cast<float>(currentStep.load()) / fullScaleSteps;
+  }
+
+ private:
+  static const uint32_t MIN_STEP_INTERVAL_MICROS = 100;  // Far above the minimum high, low, and setup times of usual drivers (1 to 2 us).
+  static const uint32_t STEP_PULSE_MICROS = 2;
+
+  const int stepPin;
+  const int directionPin;
+  const int32_t fullScaleSteps;
+  esp_timer_handle_t stepTimer = nullptr;
+  std::atomic<int32_t> currentStep{0};
+  std::atomic<int32_t> targetStep{0};
+  std::atomic<uint32_t> stepIntervalMicros{MIN_STEP_INTERVAL_MICROS};
+  std::atomic<bool> isStepping{false};
+  bool isDirectionForward = true;
+
+
+  static void onStepTimer(void* arg) {
+    static_cast<StepperGauge*>(arg)->step();
+  }
+
+
+  /// Emits one step (or the change of the direction) towards the target
+  /// step and schedules the next one. Runs in the task of the esp_timer.
+  void step() {
+    int32_t current = currentStep.load();
+    int32_t target = targetStep.load();
+    if (current == target) {
+      isStepping.store(false);
+      return;
+    }
+    bool isForward = (target > current);
+    if (isForward != isDirectionForward) {
+      digitalWrite(directionPin, isForward ? HIGH : LOW);
+      isDirectionForward = isForward;
+    } else {
+      digitalWrite(stepPin, HIGH);
+      delayMicroseconds(STEP_PULSE_MICROS);
+      digitalWrite(stepPin, LOW);
+      currentStep.store(current + (isForward ? 1 : -1));
+    }
+    esp_timer_start_once(stepTimer, stepIntervalMicros.load());
+  }
+};
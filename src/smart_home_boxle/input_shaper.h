@@ -0,0 +1,154 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+/// Zero-vibration (ZV) input shaper for a meter that behaves like an
+/// underdamped second-order system. The model is fitted from two times of
+/// the step response: the time of the first peak tp and the (2 %) settling
+/// time ts. With the damped frequency wd = pi / tp and the decay rate
+/// sigma = zeta * wn = 4 / ts, the shaper splits each change of the target
+/// into two impulses of 1 / (1 + K) and K / (1 + K), the latter delayed by
+/// tp, where K = exp(-sigma * tp) is the relative overshoot. The second
+/// impulse cancels the oscillation excited by the first one.
+class ZeroVibrationShaper {
+ public:
+  /// Configures the shaper for the given step response times and the
+  /// interval at which shape() is called. Zero times disable the shaper.
+  void configure(uint16_t peakMillis, uint16_t settlingMillis, uint16_t tickMillis) {
+    isEnabled = (peakMillis > 0 && settlingMillis > peakMillis && tickMillis > 0);
+    if (!isEnabled) {
+      history.assign(1, 0.0f);
+      return;
+    }
+    float sigma = 4.0f / (settlingMillis / 1000.0f);
+    float overshoot = std::exp(-sigma * peakMillis / 1000.0f);
+    firstImpulse = 1.0f / (1.0f + overshoot);
+    size_t delayTicks = std::max<size_t>(1, std::lround(static_cast<float>(peakMillis) / tickMillis));
+    history.assign(delayTicks + 1, lastTarget);
+    position = 0;
+  }
+
+
+  /// Returns the damping ratio of the fitted model, or NaN if disabled.
+  static float getDampingRatio(uint16_t peakMillis, uint16_t settlingMillis) {
+    if (peakMillis == 0 || settlingMillis <= peakMillis) {
+      return NAN;
+    }
+    float dampedFrequency = M_PI / (peakMillis / 1000.0f);
+    float sigma = 4.0f / (settlingMillis / 1000.0f);
+    return sigma / std::sqrt(dampedFrequency * dampedFrequency + sigma * sigma);
+  }
+
+
+  /// Returns the shaped output for the given target. Must be called once
+  /// per tick.
+  float shape(float target) {
+    lastTarget = target;
+    if (!isEnabled) {
+      return target;
+    }
+    history[position] = target;
+    position = (position + 1) % history.size();
+    float delayedTarget = history[position];  // The oldest entry, i.e., delayed by tp.
+    return firstImpulse * target + (1.0f - firstImpulse) * delayedTarget;
+  }
+
+ private:
+  bool isEnabled = false;
+  float firstImpulse = 1.0f;
+  float lastTarget = 0.0f;
+  std::vector<float> history = std::vector<float>(1, 0.0f);
+  size_t position = 0;
+};
+
+
+/// Procedure to measure the step response of the meter with the help of
+/// the user: After a rest at zero, the output jumps to STEP_LEVEL. The user
+/// marks the first peak of the needle and the moment it has settled. The
+/// procedure is pure logic, i.e., the caller passes the time and the marks
+/// and outputs the returned level.
+class StepResponseCharacterization {
+ public:
+  static constexpr float STEP_LEVEL = 0.6f;
+  static const unsigned long REST_MILLIS = 3000;
+  static const unsigned long TIMEOUT_MILLIS = 20000;
+
+
+  void start(unsigned long nowMillis) {
+    state = State::REST;
+    stateStartMillis = nowMillis;
+    peakMillis = 0;
+    settlingMillis = 0;
+  }
+
+
+  bool isActive() const {
+    return state == State::REST || state == State::STEP;
+  }
+
+
+  /// Returns true if the procedure has been completed successfully.
+  bool isCompleted() const {
+    return state == State::COMPLETED;
+  }
+
+
+  /// Advances the procedure to the given time and returns the output
+  /// level (0 to 1).
+  float update(unsigned long nowMillis) {
+    if (state == State::REST && nowMillis - stateStartMillis >= REST_MILLIS) {
+      state = State::STEP;
+      stateStartMillis = nowMillis;
+    } else if (state == State::STEP && nowMillis - stateStartMillis >= TIMEOUT_MILLIS) {
+      state = State::IDLE;
+    }
+    return (state == State::STEP) ? STEP_LEVEL : 0.0f;
+  }
+
+
+  /// Marks the first peak of the needle.
+  void markPeak(unsigned long nowMillis) {
+    if (state == State::STEP) {
+      peakMillis = nowMillis - stateStartMillis;
+    }
+  }
+
+
+  /// Marks that the needle has settled, which completes the procedure if
+  /// the peak has been marked before.
+  void markSettled(unsigned long nowMillis) {
+    if (state == State::STEP && peakMillis > 0) {
+      settlingMillis = nowMillis - stateStartMillis;
+      state = State::COMPLETED;
+    }
+  }
+
+
+  uint16_t getPeakMillis() const {
+    return static_cast<uint16_t>(std::min<unsigned long>(peakMillis, UINT16_MAX));
+  }
+
+
+  uint16_t getSettlingMillis() const {
+    return static_cast<uint16_t>(std::min<unsigned long>(settlingMillis, UINT16_MAX));
+  }
+
+ private:
+  enum class State {IDLE, REST, STEP, COMPLETED};
+
+  State state = State::IDLE;
+  unsigned long stateStartMillis = 0;
+  unsigned long peakMillis = 0;
+  unsigned long settlingMillis = 0;
+};
@@ -0,0 +1,203 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+
+// Log levels. Messages below LOG_LEVEL are eliminated at compile time,
+// i.e., their arguments are not even evaluated. Define LOG_LEVEL before
+// including this file to change it.
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE 4
+
+#ifndef LOG_LEVEL
+  #define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+
+/// Lock-free ring buffer for formatted log messages with any number of
+/// producers (tasks) and a single consumer, i.e., a low-priority task that
+/// writes the messages to Serial. A producer never blocks: If the buffer is
+/// full, the message is dropped and counted. Each slot carries a sequence
+/// number, which tells whether the slot is free for the producer at a given
+/// position or filled for the consumer (cf. the bounded queue by Dmitry
+/// Vyukov).
+class LogBuffer {
+ public:
+  static const uint32_t SLOT_COUNT = 32;  // Power of two.
+  static const size_t MESSAGE_SIZE = 160;  // Including the terminating zero.
+
+
+  LogBuffer() {
+    for (uint32_t index = 0; index < SLOT_COUNT; ++index) {
+      slots[index].sequence.store(index, std::memory_order_relaxed);
+    }
+  }
+
+  LogBuffer(const LogBuffer&) = delete;
+  LogBuffer& operator=(const LogBuffer&) = delete;
+
+
+  /// Formats the message with the given level character and timestamp as
+  /// prefix into a free slot. Returns false if the message was dropped.
+  bool push(char level, uint32_t nowMillis, const char* format, va_list arguments) {
+    uint32_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots[position % SLOT_COUNT];
+      int32_t difference = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - position);
+      if (difference == 0) {
+        if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+
+    int length = snprintf(slot->message, MESSAGE_SIZE, "%lu %c ", static_cast<unsigned long>(nowMillis), level);
+    vsnprintf(slot->message + length, MESSAGE_SIZE - length, format, arguments);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+
+  /// Copies the oldest message into the given buffer of MESSAGE_SIZE bytes.
+  /// Returns false if there is none. Must be called by the consumer only.
+  bool pop(char* message) {
+    Slot& slot = slots[dequeuePosition % SLOT_COUNT];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+      return false;
+    }
+    memcpy(message, slot.message, MESSAGE_SIZE);
+    slot.sequence.store(dequeuePosition + SLOT_COUNT, std::memory_order_release);
+    ++dequeuePosition;
+    return true;
+  }
+
+
+  /// Returns the number of messages dropped since the last call.
+  uint32_t takeDroppedCount() {
+    return droppedCount.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint32_t> sequence;
+    char message[MESSAGE_SIZE];
+  };
+
+  Slot slots[SLOT_COUNT];
+  std::atomic<uint32_t> enqueuePosition{0};
+  uint32_t dequeuePosition = 0;
+  std::atomic<uint32_t> droppedCount{0};
+};
+
+
+/// Returns the log buffer shared by all tasks.
+inline LogBuffer& getLogBuffer() {
+  static LogBuffer buffer;
+  return buffer;
+}
+
+
+/// Formats the given message into the log buffer.
+inline void logMessage(char level, uint32_t nowMillis, const char* format, ...) __attribute__((format(printf, 3, 4)));
+inline void logMessage(char level, uint32_t nowMillis, const char* format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  getLogBuffer().push(level, nowMillis, format, arguments);
+  va_end(arguments);
+}
+
+
+/// Lets a message pass at most once per interval and counts the suppressed
+/// ones, e.g., for messages logged while a push button is held. Each call
+/// site of the LOG_*_EVERY macros has its own limiter.
+class LogRateLimiter {
+ public:
+  explicit LogRateLimiter(uint32_t intervalMillis)
+  : intervalMillis(intervalMillis) {}
+
+
+  /// Returns true if a message may pass at the given time. In this case,
+  /// suppressedCount is set to the number of messages suppressed before.
+  bool tryPass(uint32_t nowMillis, uint32_t& suppressedCount) {
+    uint32_t last = lastPassMillis.load(std::memory_order_relaxed);
+    if (hasPassed.load(std::memory_order_relaxed) && nowMillis - last < intervalMillis) {
+      suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (!lastPassMillis.compare_exchange_strong(last, nowMillis, std::memory_order_relaxed)) {
+      suppressed.fetch_add(1, std::memory_order_relaxed);  // Another task passed concurrently.
+      return false;
+    }
+    hasPassed.store(true, std::memory_order_relaxed);
+    suppressedCount = suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+ private:
+  const uint32_t intervalMillis;
+  std::atomic<uint32_t> lastPassMillis{0};
+  std::atomic<bool> hasPassed{false};
+  std::atomic<uint32_t> suppressed{0};
+};
+
+
+#define LOG_AT(level, ...) logMessage(level, millis(), __VA_ARGS__)
+
+#define LOG_AT_EVERY(level, intervalMillis, ...) do { \
+    static LogRateLimiter logRateLimiter(intervalMillis); \
+    uint32_t logSuppressedCount = 0; \
+    if (logRateLimiter.tryPass(millis(), logSuppressedCount)) { \
+      if (logSuppressedCount > 0) { \
+        LOG_AT(level, "(%lu similar messages suppressed)", static_cast<unsigned long>(logSuppressedCount)); \
+      } \
+      LOG_AT(level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+  #define LOG_DEBUG(...) LOG_AT('D', __VA_ARGS__)
+  #define LOG_DEBUG_EVERY(intervalMillis, ...) LOG_AT_EVERY('D', intervalMillis, __VA_ARGS__)
+#else
+  #define LOG_DEBUG(...) do {} while (0)
+  #define LOG_DEBUG_EVERY(intervalMillis, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+  #define LOG_INFO(...) LOG_AT('I', __VA_ARGS__)
+  #define LOG_INFO_EVERY(intervalMillis, ...) LOG_AT_EVERY('I', intervalMillis, __VA_ARGS__)
+#else
+  #define LOG_INFO(...) do {} while (0)
+  #define LOG_INFO_EVERY(intervalMillis, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARNING
+  #define LOG_WARNING(...) LOG_AT('W', __VA_ARGS__)
+#else
+  #define LOG_WARNING(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+  #define LOG_ERROR(...) LOG_AT('E', __VA_ARGS__)
+#else
+  #define LOG_ERROR(...) do {} while (0)
+#endif
@@ -0,0 +1,95 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+/// Trapezoidal motion profile for a needle position in the range 0 to 1,
+/// i.e., the needle accelerates with a constant acceleration up to the
+/// maximum velocity and decelerates such that it stops exactly at the
+/// target. The profile is pure computation without any hardware access.
+class MotionProfile {
+ public:
+  /// Ctor expecting the maximum velocity (full scale per second) and the
+  /// acceleration (full scale per second squared).
+  MotionProfile(float maxVelocity, float acceleration)
+  : maxVelocity(maxVelocity), acceleration(acceleration)
+  {
+    assert(maxVelocity > 0.0f);
+    assert(acceleration > 0.0f);
+  }
+
+
+  void setTarget(float newTarget) {
+    target = std::min(std::max(newTarget, 0.0f), 1.0f);
+  }
+
+
+  float getTarget() const {
+    return target;
+  }
+
+
+  float getPosition() const {
+    return position;
+  }
+
+
+  float getVelocity() const {
+    return velocity;
+  }
+
+
+  /// Returns true if the needle rests at the target.
+  bool isAtTarget() const {
+    return position == target && velocity == 0.0f;
+  }
+
+
+  /// Advances the motion by the given time step and returns the new position.
+  float update(float dtSeconds) {
+    float distance = target - position;
+    if (std::fabs(distance) < 1e-6f && std::fabs(velocity) <= acceleration * dtSeconds) {
+      position = target;
+      velocity = 0.0f;
+      return position;
+    }
+
+    float direction = (distance > 0.0f) ? 1.0f : -1.0f;
+    float speed = velocity * direction;  // Positive if moving towards the target.
+    float speedChange = acceleration * dtSeconds;
+    // Fastest new speed from which the needle can still stop at the target
+    // after this step, i.e., newSpeed^2 / (2 a) <= distance - (speed +
+    // newSpeed) / 2 * dt. If the needle is faster (e.g., due to a new target
+    // behind its stopping point), it decelerates, overshoots, and returns.
+    float remainingDistance = std::max(std::fabs(distance) - 0.5f * speed * dtSeconds, 0.0f);
+    float brakingSpeed = std::sqrt(0.25f * speedChange * speedChange + 2.0f * acceleration * remainingDistance) - 0.5f * speedChange;
+    float newSpeed = std::min(std::min(speed + speedChange, maxVelocity), brakingSpeed);
+    newSpeed = std::max(newSpeed, speed - speedChange);
+
+    float newPosition = position + direction * 0.5f * (speed + newSpeed) * dtSeconds;
+    velocity = direction * newSpeed;
+    if ((target - newPosition) * direction <= 0.0f && newSpeed <= 2.0f * speedChange) {
+      // Stop at the target instead of overshooting due to the discrete time steps.
+      newPosition = target;
+      velocity = 0.0f;
+    }
+    position = newPosition;
+    return position;
+  }
+
+ private:
+  const float maxVelocity;
+  const float acceleration;
+  float target = 0.0f;
+  float position = 0.0f;
+  float velocity = 0.0f;
+};
@@ -0,0 +1,164 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+
+/// Short-term forecaster for P_AC between two updates by Holt's linear
+/// exponential smoothing, adapted to irregular sample intervals. The level
+/// is snapped to each fresh sample, so that the forecast at the time of an
+/// update equals the reported P_AC, and only the trend (in watts per
+/// second) is smoothed. The forecast extrapolates the trend for at most
+/// maxHorizonSeconds and is limited to zero. An optional upper bound, e.g.,
+/// the clear-sky production at the forecast time, only limits the
+/// extrapolation, i.e., the forecast never drops below the last sample
+/// because of it. After a gap of more than maxGapSeconds (e.g., over
+/// night), the forecaster starts over.
+class PacForecaster {
+ public:
+  /// Function returning the upper bound of P_AC at the given timestamp.
+  typedef std::function<float(double timestamp)> UpperBound;
+
+
+  PacForecaster(float trendSmoothing = 0.1f, double maxHorizonSeconds = 600.0, double maxGapSeconds = 3600.0)
+  : trendSmoothing(trendSmoothing), maxHorizonSeconds(maxHorizonSeconds), maxGapSeconds(maxGapSeconds) {}
+
+
+  void setUpperBound(const UpperBound& bound) {
+    upperBound = bound;
+  }
+
+
+  /// Adds the given sample. Samples not newer than the last one are ignored.
+  void addSample(double timestamp, float pAC) {
+    if (std::isnan(pAC) || (hasEstimate && timestamp <= lastTimestamp)) {
+      return;
+    }
+    double dt = timestamp - lastTimestamp;
+    if (!hasEstimate || dt > maxGapSeconds) {
+      level = pAC;
+      trend = 0.0f;
+      hasEstimate = true;
+    } else {
+      trend = trendSmoothing * (pAC - level) / static_cast<float>(dt) + (1.0f - trendSmoothing) * trend;
+      level = pAC;
+    }
+    lastTimestamp = timestamp;
+  }
+
+
+  /// Returns true if at least one sample has been added.
+  bool hasForecast() const {
+    return hasEstimate;
+  }
+
+
+  /// Returns the forecast of P_AC at the given timestamp, or NaN if there
+  /// is no sample yet.
+  float getForecast(double timestamp) const {
+    if (!hasEstimate) {
+      return NAN;
+    }
+    double horizon = std::min(std::max(timestamp - lastTimestamp, 0.0), maxHorizonSeconds);
+    float forecast = std::max(level + trend * static_cast<float>(horizon), 0.0f);
+    if (upperBound) {
+      float bound = upperBound(timestamp);
+      if (!std::isnan(bound)) {
+        forecast = std::min(forecast, std::max(bound, level));
+      }
+    }
+    return forecast;
+  }
+
+ private:
+  const float trendSmoothing;
+  const double maxHorizonSeconds;
+  const double maxGapSeconds;
+  UpperBound upperBound;
+  bool hasEstimate = false;
+  double lastTimestamp = 0.0;
+  float level = 0.0f;
+  float trend = 0.0f;
+};
+
+
+/// Backtest of a PacForecaster on recorded samples: Like on the box, the
+/// forecaster only sees a sample every updateIntervalSeconds. All samples in
+/// between are compared with the forecast and with the last seen sample
+/// (i.e., holding the value, as without forecaster).
+class PacForecastBacktest {
+ public:
+  PacForecastBacktest(const PacForecaster& forecaster, double updateIntervalSeconds)
+  : forecaster(forecaster), updateIntervalSeconds(updateIntervalSeconds) {}
+
+
+  /// Adds the given recorded sample. Samples must be added in time order.
+  void addSample(double timestamp, float pAC) {
+    if (std::isnan(pAC)) {
+      return;
+    }
+    if (!hasUpdate || timestamp - lastUpdateTimestamp >= updateIntervalSeconds) {
+      forecaster.addSample(timestamp, pAC);
+      heldValue = pAC;
+      lastUpdateTimestamp = timestamp;
+      hasUpdate = true;
+      return;
+    }
+    float forecastError = forecaster.getForecast(timestamp) - pAC;
+    float holdError = heldValue - pAC;
+    sumAbsoluteForecastError += std::fabs(forecastError);
+    sumSquaredForecastError += forecastError * forecastError;
+    sumAbsoluteHoldError += std::fabs(holdError);
+    sumSquaredHoldError += holdError * holdError;
+    ++comparedCount;
+  }
+
+
+  long getComparedCount() const {
+    return comparedCount;
+  }
+
+
+  /// Returns the mean absolute error of the forecast in watts.
+  float getForecastMae() const {
+    return (comparedCount > 0) ? static_cast<float>(sumAbsoluteForecastError / comparedCount) : NAN;
+  }
+
+
+  /// Returns the root mean square error of the forecast in watts.
+  float getForecastRmse() const {
+    return (comparedCount > 0) ? static_cast<float>(std::sqrt(sumSquaredForecastError / comparedCount)) : NAN;
+  }
+
+
+  /// Returns the mean absolute error of holding the last value in watts.
+  float getHoldMae() const {
+    return (comparedCount > 0) ? static_cast<float>(sumAbsoluteHoldError / comparedCount) : NAN;
+  }
+
+
+  /// Returns the root mean square error of holding the last value in watts.
+  float getHoldRmse() const {
+    return (comparedCount > 0) ? static_cast<float>(std::sqrt(sumSquaredHoldError / comparedCount)) : NAN;
+  }
+
+ private:
+  PacForecaster forecaster;
+  const double updateIntervalSeconds;
+  bool hasUpdate = false;
+  double lastUpdateTimestamp = 0.0;
+  float heldValue = 0.0f;
+  double sumAbsoluteForecastError = 0.0;
+  double sumSquaredForecastError = 0.0;
+  double sumAbsoluteHoldError = 0.0;
+  double sumSquaredHoldError = 0.0;
+  long comparedCount = 0;
+};
@@ -7,6 +7,8 @@
 #pragma once
 
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <vector>
 
@@ -25,6 +27,28 @@ struct PlotPoint {
 };
 
 
+/// Represents the range of an axis with its ticks.
+struct PlotAxis {
+  double min;
+  double max;
+  std::vector<PlotTick> ticks;
+};
+
+
+/// Represents the aggregation of several points (e.g., within one pixel
+/// column) at the given x value.
+struct PlotBucket {
+  double x;
+  double minY;
+  double medianY;
+  double maxY;
+};
+
+
+/// Represents a contiguous part of a series, i.e., without missing samples.
+typedef std::vector<PlotPoint> PlotSegment;
+
+
 /// Generic class to render a 2D plot with linear axes. The class is generic
 /// in the sense that the actual drawing functions are passed by function
 /// pointers or lambda expressions, i.e., it may be used with any type of
@@ -43,6 +67,91 @@ class PlotUtility {
   }
 
 
+  /// Adds two series given as segments at the union of their x values. Each
+  /// series contributes its value linearly interpolated within its segments
+  /// and zero outside of them, e.g., where an inverter was offline. Both
+  /// series are expected to be sorted by x.
+  static PlotSegment addSeries(const std::vector<PlotSegment>& first, const std::vector<PlotSegment>& second) {
+    std::vector<double> xValues;
+    for (const std::vector<PlotSegment>* series : {&first, &second}) {
+      for (const PlotSegment& segment : *series) {
+        for (const PlotPoint& point : segment) {
+          xValues.push_back(point.x);
+        }
+      }
+    }
+    std::sort(xValues.begin(), xValues.end());
+    xValues.erase(std::unique(xValues.begin(), xValues.end()), xValues.end());
+
+    PlotSegment result;
+    result.reserve(xValues.size());
+    SeriesCursor firstCursor(first);
+    SeriesCursor secondCursor(second);
+    for (double x : xValues) {
+      result.push_back({x, firstCursor.getValueAt(x) + secondCursor.getValueAt(x)});
+    }
+    return result;
+  }
+
+
+  /// Computes a y axis covering all given segments (in a single pass over
+  /// the points) with "nice" ticks at multiples of 1, 2, or 5 times a power
+  /// of ten. The limits fixedMinY and fixedMaxY are used as they are unless
+  /// they are NaN. The range spans at least minSpan, centered on the data if
+  /// both limits are computed. At most maxTickCount ticks are generated.
+  static PlotAxis computeNiceYAxis(const std::vector<PlotSegment>& segments, double fixedMinY, double fixedMaxY, double minSpan, int maxTickCount) {
+    assert(minSpan > 0.0);
+    assert(maxTickCount >= 2);
+
+    double dataMin = INFINITY;
+    double dataMax = -INFINITY;
+    for (const PlotSegment& segment : segments) {
+      for (const PlotPoint& point : segment) {
+        dataMin = std::min(dataMin, point.y);
+        dataMax = std::max(dataMax, point.y);
+      }
+    }
+    if (dataMin > dataMax) {
+      // No data at all.
+      dataMin = std::isnan(fixedMinY) ? 0.0 : fixedMinY;
+      dataMax = dataMin;
+    }
+
+    double low = std::isnan(fixedMinY) ? dataMin : fixedMinY;
+    double high = std::isnan(fixedMaxY) ? dataMax : fixedMaxY;
+    if (high - low < minSpan) {
+      if (std::isnan(fixedMinY) && std::isnan(fixedMaxY)) {
+        double center = (low + high) / 2.0;
+        low = center - minSpan / 2.0;
+        high = center + minSpan / 2.0;
+      } else if (std::isnan(fixedMaxY)) {
+        high = low + minSpan;
+      } else {
+        low = high - minSpan;
+      }
+    }
+
+    double step = getNiceNumber((high - low) / (maxTickCount - 1));
+    double niceLow = std::isnan(fixedMinY) ? std::floor(low / step + 1e-9) * step : low;
+    double niceHigh = std::isnan(fixedMaxY) ? std::ceil(high / step - 1e-9) * step : high;
+    while (std::floor(niceHigh / step + 1e-9) - std::ceil(niceLow / step - 1e-9) + 1 > maxTickCount) {
+      step = getNiceNumber(step * 1.5);
+      niceLow = std::isnan(fixedMinY) ? std::floor(low / step + 1e-9) * step : low;
+      niceHigh = std::isnan(fixedMaxY) ? std::ceil(high / step - 1e-9) * step : high;
+    }
+    low = niceLow;
+    high = niceHigh;
+
+    int decimals = std::max(0, static_cast<int>(-std::floor(std::log10(step) + 1e-9)));
+    PlotAxis axis{low, high, {}};
+    for (long index = static_cast<long>(std::ceil(low / step - 1e-9)); index * step <= high + 1e-9 * step; ++index) {
+      double value = std::min(std::max(index * step, low), high);
+      axis.ticks.push_back({value, String(value, decimals)});
+    }
+    return axis;
+  }
+
+
   /// Sets the ticks (string label at given value) on the x axis.
   void setXTicks(const std::vector<PlotTick>& ticks) {
     for (const auto& tick : ticks) {
@@ -83,12 +192,25 @@ class PlotUtility {
   }
 
 
+  /// Returns whether the given y value is within the range of the y axis.
+  bool isYValueInRange(double y) const {
+    return minY <= y && y <= maxY;
+  }
+
+
   /// Computes the x pixel value for the given x value in the plot range.
   int getXPixelForXValue(double x) {
     return static_cast<int>(posX + (width - 1) * (x - minX) / (maxX - minX) + 0.5);
   }
 
 
+  /// Computes the x value at the given x pixel, i.e., the inverse of
+  /// getXPixelForXValue.
+  double getXValueForXPixel(int x) {
+    return minX + (maxX - minX) * (x - posX) / (width - 1);
+  }
+
+
   /// Computes the y pixel value for the given y value in the plot range.
   int getYPixelForYValue(double y) {
     return static_cast<int>(posY + (height - 1) * (maxY - y) / (maxY - minY) + 0.5);
@@ -123,6 +245,31 @@ class PlotUtility {
   }
 
 
+  /// Splits the given series into segments at missing samples (i.e., y is
+  /// NaN) and at gaps where the distance between two consecutive x values
+  /// exceeds maxGapX. Missing samples are dropped. This is meant to be done
+  /// once per series so that the drawing functions below do not need to
+  /// check for missing data per point.
+  static std::vector<PlotSegment> splitIntoSegments(const std::vector<PlotPoint>& points, double maxGapX) {
+    std::vector<PlotSegment> segments;
+    double prevX = 0.0;
+    bool isSegmentOpen = false;
+    for (const PlotPoint& point : points) {
+      if (std::isnan(point.y)) {
+        isSegmentOpen = false;
+        continue;
+      }
+      if (!isSegmentOpen || point.x - prevX > maxGapX) {
+        segments.emplace_back();
+        isSegmentOpen = true;
+      }
+      segments.back().push_back(point);
+      prevX = point.x;
+    }
+    return segments;
+  }
+
+
   /// Draws the given points in the plot area using the given function
   /// to draw a point at x0,y0.
   void drawPoints(const std::vector<PlotPoint>& points, std::function<void(int,int,PlotPoint)> drawPointFunc) {
@@ -155,7 +302,222 @@ class PlotUtility {
     }
   }
 
+
+  /// Draws the points of all given segments, cf. drawPoints above.
+  void drawPoints(const std::vector<PlotSegment>& segments, std::function<void(int,int,PlotPoint)> drawPointFunc) {
+    for (const PlotSegment& segment : segments) {
+      drawPoints(segment, drawPointFunc);
+    }
+  }
+
+
+  /// Draws lines between consecutive points within each of the given
+  /// segments, but not across segments, cf. drawLinesBetweenPoints above.
+  void drawLinesBetweenPoints(const std::vector<PlotSegment>& segments, std::function<void(int,int,int,int,PlotPoint,PlotPoint)> drawLineFunc) {
+    for (const PlotSegment& segment : segments) {
+      drawLinesBetweenPoints(segment, drawLineFunc);
+    }
+  }
+
+
+  /// Draws one bar per given point from the y value 0 (or the nearest
+  /// limit of the y axis) to the point using the given function to fill a
+  /// rectangle at x0,y0 with width and height. The bars are centered on the
+  /// x values of the points.
+  void drawBars(const std::vector<PlotPoint>& points, int barWidth, std::function<void(int,int,int,int,PlotPoint)> drawBarFunc) {
+    int yBase = getYPixelForYValue(std::min(std::max(0.0, minY), maxY));
+    for (const PlotPoint& point : points) {
+      int x = getXPixelForXValue(point.x);
+      int y = getYPixelForYValue(std::min(std::max(point.y, minY), maxY));
+      drawBarFunc(x - barWidth / 2, std::min(y, yBase), barWidth, std::abs(y - yBase) + 1, point);
+    }
+  }
+
+
+  /// Fills the area between the curve through the given points and the
+  /// x axis by one vertical span per pixel column. The curve is linearly
+  /// interpolated between consecutive points. The given function is called
+  /// with x, the y pixel of the curve (clipped to the plot area), and the
+  /// y pixel of the x axis. Hence, the effort is O(width) independent of
+  /// the number of points.
+  void drawAreaUnderPoints(const std::vector<PlotPoint>& points, std::function<void(int,int,int)> drawColumnFunc) {
+    int yBottom = posY + height - 1;
+    walkColumns(points, [this, yBottom](const PlotPoint& point, int& x, int& yTop, int& yLow) {
+      x = getXPixelForXValue(point.x);
+      yTop = getYPixelForYValue(point.y);
+      yLow = yBottom;
+    }, drawColumnFunc);
+  }
+
+
+  /// Fills the area under each of the given segments, leaving the gaps
+  /// between segments empty, cf. drawAreaUnderPoints above.
+  void drawAreaUnderPoints(const std::vector<PlotSegment>& segments, std::function<void(int,int,int)> drawColumnFunc) {
+    for (const PlotSegment& segment : segments) {
+      drawAreaUnderPoints(segment, drawColumnFunc);
+    }
+  }
+
+
+  /// Draws the given reference series (e.g., an expected curve) as dotted
+  /// line with one dot every dotSpacing pixel columns. The series is
+  /// linearly interpolated between the points, and the given function is
+  /// called with x and y of each dot. Dots outside of the y range are
+  /// omitted.
+  void drawReferenceSeries(const std::vector<PlotPoint>& points, int dotSpacing, std::function<void(int,int)> drawDotFunc) {
+    int yBottom = posY + height - 1;
+    walkColumns(points, [this](const PlotPoint& point, int& x, int& yTop, int& yLow) {
+      x = getXPixelForXValue(point.x);
+      yTop = getYPixelForYValue(point.y);
+      yLow = yTop;
+    }, [this, yBottom, dotSpacing, &drawDotFunc](int x, int y, int) {
+      if ((x - posX) % dotSpacing == 0 && y > posY && y < yBottom) {
+        drawDotFunc(x, y);
+      }
+    });
+  }
+
+
+  /// Aggregates the given segment into one bucket per pixel column with
+  /// minimum, median, and maximum of the y values in that column. The x
+  /// value of each bucket is the value at the center of the column. The
+  /// points are expected to be sorted by x.
+  std::vector<PlotBucket> aggregateIntoColumns(const PlotSegment& segment) {
+    std::vector<PlotBucket> buckets;
+    std::vector<double> values;
+    int column = 0;
+    auto closeBucket = [&]() {
+      if (values.empty()) {
+        return;
+      }
+      auto middle = values.begin() + values.size() / 2;
+      std::nth_element(values.begin(), middle, values.end());
+      auto minMax = std::minmax_element(values.begin(), values.end());
+      buckets.push_back({getXValueForXPixel(column), *minMax.first, *middle, *minMax.second});
+      values.clear();
+    };
+    for (const PlotPoint& point : segment) {
+      int x = getXPixelForXValue(point.x);
+      if (x != column) {
+        closeBucket();
+        column = x;
+      }
+      values.push_back(point.y);
+    }
+    closeBucket();
+    return buckets;
+  }
+
+
+  /// Returns the medians of the given buckets as points, e.g., for drawing
+  /// them by drawLinesBetweenPoints.
+  static PlotSegment getMedians(const std::vector<PlotBucket>& buckets) {
+    PlotSegment medians;
+    medians.reserve(buckets.size());
+    for (const PlotBucket& bucket : buckets) {
+      medians.push_back({bucket.x, bucket.medianY});
+    }
+    return medians;
+  }
+
+
+  /// Draws the envelope between minimum and maximum of the given buckets
+  /// by one vertical span per pixel column. Columns without bucket are
+  /// interpolated between their neighbors. The given function is called
+  /// with x and the y pixels of the maximum and the minimum.
+  void drawEnvelope(const std::vector<PlotBucket>& buckets, std::function<void(int,int,int)> drawColumnFunc) {
+    walkColumns(buckets, [this](const PlotBucket& bucket, int& x, int& yTop, int& yLow) {
+      x = getXPixelForXValue(bucket.x);
+      yTop = getYPixelForYValue(bucket.maxY);
+      yLow = getYPixelForYValue(bucket.minY);
+    }, drawColumnFunc);
+  }
+
  private:
+  /// Interpolates a series given as segments at increasing x values in
+  /// linear time in total.
+  class SeriesCursor {
+   public:
+    explicit SeriesCursor(const std::vector<PlotSegment>& segments) : segments(segments) {}
+
+    /// Returns the value at x, which must not decrease between calls, or
+    /// zero if x is outside of all segments.
+    double getValueAt(double x) {
+      while (segmentIndex < segments.size() && segments[segmentIndex].back().x < x) {
+        ++segmentIndex;
+        pointIndex = 0;
+      }
+      if (segmentIndex == segments.size() || x < segments[segmentIndex].front().x) {
+        return 0.0;
+      }
+      const PlotSegment& segment = segments[segmentIndex];
+      while (pointIndex + 1 < segment.size() && segment[pointIndex + 1].x <= x) {
+        ++pointIndex;
+      }
+      const PlotPoint& point0 = segment[pointIndex];
+      if (point0.x == x || pointIndex + 1 == segment.size()) {
+        return point0.y;
+      }
+      const PlotPoint& point1 = segment[pointIndex + 1];
+      return point0.y + (point1.y - point0.y) * (x - point0.x) / (point1.x - point0.x);
+    }
+
+   private:
+    const std::vector<PlotSegment>& segments;
+    size_t segmentIndex = 0;
+    size_t pointIndex = 0;
+  };
+
+
+  /// Walks all pixel columns from the first to the last of the given items,
+  /// which are sorted by x. For each item, getPixelsFunc yields its column
+  /// and two y pixels. Both y pixels are linearly interpolated between
+  /// consecutive items, clipped to the plot area, and passed together with
+  /// the column to drawColumnFunc.
+  template <typename Item, typename GetPixelsFunc>
+  void walkColumns(const std::vector<Item>& items, GetPixelsFunc getPixelsFunc, const std::function<void(int,int,int)>& drawColumnFunc) {
+    int yBottom = posY + height - 1;
+    int prevX = 0;
+    int prevY0 = 0;
+    int prevY1 = 0;
+    int nextColumn = posX;
+    bool isFirst = true;
+    for (const Item& item : items) {
+      int x;
+      int y0;
+      int y1;
+      getPixelsFunc(item, x, y0, y1);
+      if (isFirst) {
+        isFirst = false;
+        prevX = x;
+        prevY0 = y0;
+        prevY1 = y1;
+        nextColumn = std::max(nextColumn, x);
+      }
+      for (int column = nextColumn; column <= x && column < posX + width; ++column) {
+        int columnY0 = (x == prevX) ? y0 : prevY0 + (y0 - prevY0) * (column - prevX) / (x - prevX);
+        int columnY1 = (x == prevX) ? y1 : prevY1 + (y1 - prevY1) * (column - prevX) / (x - prevX);
+        columnY0 = std::min(std::max(columnY0, posY), yBottom);
+        columnY1 = std::min(std::max(columnY1, posY), yBottom);
+        drawColumnFunc(column, columnY0, columnY1);
+      }
+      nextColumn = std::max(nextColumn, x + 1);
+      prevX = x;
+      prevY0 = y0;
+      prevY1 = y1;
+    }
+  }
+
+
+  /// Returns the "nice" number (1, 2, or 5 times a power of ten) closest
+  /// to the given value.
+  static double getNiceNumber(double value) {
+    double exponent = std::floor(std::log10(value));
+    double fraction = value / std::pow(10.0, exponent);
+    double niceFraction = (fraction < 1.5) ? 1.0 : (fraction < 3.0) ? 2.0 : (fraction < 7.0) ? 5.0 : 10.0;
+    return niceFraction * std::pow(10.0, exponent);
+  }
+
   const int posX;
   const int posY;
   const int width;
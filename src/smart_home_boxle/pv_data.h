@@ -0,0 +1,124 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <vector>
+
+#include "data_quality.h"
+
+
+/// Struct for a single data item from the photovoltaic system. Values not
+/// reported (yet) are NaN. The quality flags are assessed once per update
+/// by assessQuality().
+struct PVSingleData {
+  double age = INFINITY;
+  time_t timestamp = 0;  // Time of the reported values, 0 if unknown.
+  float pAC = NAN;
+  float uAC = NAN;
+  float frequency = NAN;
+  float temperature = NAN;
+  float efficiency = NAN;
+  float totalYield = NAN;
+  float todayYield = NAN;
+  DataQualityFlags quality;
+
+  float getValue(PVField field) const {
+    switch (field) {
+      case PV_FIELD_PAC: return pAC;
+      case PV_FIELD_UAC: return uAC;
+      case PV_FIELD_FREQUENCY: return frequency;
+      case PV_FIELD_TEMPERATURE: return temperature;
+      case PV_FIELD_EFFICIENCY: return efficiency;
+      case PV_FIELD_TOTAL_YIELD: return totalYield;
+      case PV_FIELD_TODAY_YIELD: return todayYield;
+      default: return NAN;
+    }
+  }
+
+  /// Assesses the quality of all fields. Without a valid total yield (e.g.,
+  /// zero), the inverter has not reported yet, hence all reported values of
+  /// the age-relevant fields are INVALID as well.
+  void assessQuality(double maxAgeSeconds) {
+    for (int field = 0; field < PV_FIELD_COUNT; ++field) {
+      PVField pvField = static_cast<PVField>(field);
+      quality.set(pvField, DataQualityFlags::assessValue(pvField, getValue(pvField), age, maxAgeSeconds));
+    }
+    if (!quality.isValid(PV_FIELD_TOTAL_YIELD)) {
+      for (int field = 0; field < PV_FIELD_COUNT; ++field) {
+        PVField pvField = static_cast<PVField>(field);
+        if (PV_FIELD_SPECS[pvField].isAgeRelevant && quality.isValid(pvField)) {
+          quality.set(pvField, DataQuality::INVALID);
+        }
+      }
+    }
+  }
+};
+
+
+/// Combines the newest data of several channels. For P_AC, the
+/// temperature, the efficiency, and the total yield, only the channels with
+/// the best quality of the respective field are taken into account, i.e.,
+/// the fresh ones if there is any fresh one. Of these, P_AC and the total
+/// yield are summed up, the temperature is the maximum, and the efficiency
+/// the mean. The combined field gets this best quality. Thus, the last
+/// value of an inverter gone offline is not added to the ones of the others.
+/// The age and the timestamp are the ones of the oldest and newest channel
+/// contributing to P_AC, respectively. The grid values are taken from the
+/// first channel.
+inline PVSingleData combinePVData(const std::vector<PVSingleData>& channelData, float todayYield, double maxAgeSeconds) {
+  PVSingleData combined;
+  if (channelData.empty()) {
+    return combined;
+  }
+  combined.uAC = channelData.front().uAC;
+  combined.frequency = channelData.front().frequency;
+  combined.todayYield = todayYield;
+  combined.assessQuality(maxAgeSeconds);
+  for (PVField field : {PV_FIELD_UAC, PV_FIELD_FREQUENCY}) {
+    combined.quality.set(field, channelData.front().quality.get(field));
+  }
+
+  for (PVField field : {PV_FIELD_PAC, PV_FIELD_TEMPERATURE, PV_FIELD_EFFICIENCY, PV_FIELD_TOTAL_YIELD}) {
+    DataQuality best = DataQuality::MISSING;
+    for (const PVSingleData& data : channelData) {
+      best = std::max(best, data.quality.get(field));
+    }
+    combined.quality.set(field, best);
+    if (best != DataQuality::FRESH && best != DataQuality::STALE) {
+      continue;
+    }
+
+    float sum = 0.0f;
+    float maximum = -INFINITY;
+    int count = 0;
+    for (const PVSingleData& data : channelData) {
+      if (data.quality.get(field) != best) {
+        continue;
+      }
+      float value = data.getValue(field);
+      sum += value;
+      maximum = std::max(maximum, value);
+      ++count;
+      if (field == PV_FIELD_PAC) {
+        combined.age = (count == 1) ? data.age : std::max(combined.age, data.age);
+        combined.timestamp = std::max(combined.timestamp, data.timestamp);
+      }
+    }
+    switch (field) {
+      case PV_FIELD_PAC: combined.pAC = sum; break;
+      case PV_FIELD_TEMPERATURE: combined.temperature = maximum; break;
+      case PV_FIELD_EFFICIENCY: combined.efficiency = sum / count; break;
+      case PV_FIELD_TOTAL_YIELD: combined.totalYield = sum; break;
+      default: break;
+    }
+  }
+  return combined;
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+
+#include <GxEPD2.h>
+
+
+/// Simulated e-paper panel with the driver interface of the given GxEPD2
+/// panel (e.g., GxEPD2_583c_Z83), i.e., it can be used in place of it in
+/// TriColorDisplay. Nothing is sent to any hardware. Instead, every window
+/// write is recorded and the time the panel would be busy is modeled from
+/// the SPI clock and the refresh and power times of the real panel. This
+/// allows to compare refresh strategies quantitatively without waiting for
+/// the real panel.
+template <typename RealPanel>
+class SimulatedPanel {
+ public:
+  static const uint16_t WIDTH = RealPanel::WIDTH;
+  static const uint16_t HEIGHT = RealPanel::HEIGHT;
+  static const GxEPD2::Panel panel = RealPanel::panel;
+  static const bool hasColor = RealPanel::hasColor;
+  static const bool hasPartialUpdate = RealPanel::hasPartialUpdate;
+  static const bool hasFastPartialUpdate = RealPanel::hasFastPartialUpdate;
+  static const uint16_t power_on_time = RealPanel::power_on_time;
+  static const uint16_t power_off_time = RealPanel::power_off_time;
+  static const uint16_t full_refresh_time = RealPanel::full_refresh_time;
+  static const uint16_t partial_refresh_time = RealPanel::partial_refresh_time;
+
+  /// Record of a single write of an image window into the panel memory.
+  struct WindowWrite {
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+    uint32_t bytes;
+  };
+
+  /// Statistics of one cycle, i.e., since the last call of startCycle.
+  struct CycleReport {
+    uint32_t writtenBytes = 0;
+    uint16_t fullRefreshCount = 0;
+    uint16_t partialRefreshCount = 0;
+    uint16_t powerCycleCount = 0;
+    uint32_t transferMillis = 0;
+    uint32_t refreshMillis = 0;
+    uint32_t powerMillis = 0;
+
+    /// Returns the total time the panel (or the SPI bus) is busy.
+    uint32_t getBusyMillis() const {
+      return transferMillis + refreshMillis + powerMillis;
+    }
+  };
+
+
+  /// Ctor with the same arguments as the real panel, which are ignored.
+  SimulatedPanel(int16_t cs = -1, int16_t dc = -1, int16_t rst = -1, int16_t busy = -1) {}
+
+
+  /// Sets the modeled SPI clock, cf. the SPISettings of GxEPD2.
+  void setSpiClock(uint32_t hz) {
+    spiClockHz = hz;
+  }
+
+
+  void init(uint32_t serialDiagBitrate = 0) {
+    startCycle();
+  }
+
+
+  /// Accepts a busy callback like the real panel, which is never called
+  /// since the simulated panel is never busy.
+  void setBusyCallback(void (*busyCallback)(const void*), const void* busyCallbackParameter = 0) {}
+
+
+  /// Starts a new cycle, i.e., clears the recorded writes and statistics.
+  void startCycle() {
+    windowWrites.clear();
+    report = CycleReport();
+  }
+
+
+  /// Returns the statistics of the current cycle.
+  const CycleReport& getCycleReport() const {
+    return report;
+  }
+
+
+  /// Returns all window writes of the current cycle.
+  const std::vector<WindowWrite>& getWindowWrites() const {
+    return windowWrites;
+  }
+
+
+  /// Records the write of the given window of both planes, cf.
+  /// GxEPD2_583c_Z83::writeImage.
+  void writeImage(const uint8_t* black, const uint8_t* color, int16_t x, int16_t y, int16_t w, int16_t h,
+                  bool invert = false, bool mirror_y = false, bool pgm = false) {
+    uint32_t bytes = 2 * static_cast<uint32_t>((w + 7) / 8) * h;
+    windowWrites.push_back({x, y, w, h, bytes});
+    report.writtenBytes += bytes;
+    report.transferMillis += static_cast<uint32_t>(8ULL * bytes * 1000 / spiClockHz);
+  }
+
+
+  /// Records the write of the given part of both planes, cf.
+  /// GxEPD2_583c_Z83::writeImagePart.
+  void writeImagePart(const uint8_t* black, const uint8_t* color, int16_t x_part, int16_t y_part, int16_t w_bitmap, int16_t h_bitmap,
+                      int16_t x, int16_t y, int16_t w, int16_t h, bool invert = false, bool mirror_y = false, bool pgm = false) {
+    writeImage(black, color, x, y, w, h);
+  }
+
+
+  /// Models a full or partial refresh of the whole screen.
+  void refresh(bool partial_update_mode = false) {
+    powerOnIfRequired();
+    if (partial_update_mode && hasPartialUpdate) {
+      ++report.partialRefreshCount;
+      report.refreshMillis += partial_refresh_time;
+    } else {
+      ++report.fullRefreshCount;
+      report.refreshMillis += full_refresh_time;
+    }
+  }
+
+
+  /// Models a partial refresh of the given window. Like most tri-color
+  /// panels, the panel may not support partial refreshes, which are then
+  /// done as full refreshes.
+  void refresh(int16_t x, int16_t y, int16_t w, int16_t h) {
+    refresh(true);
+  }
+
+
+  void powerOff() {
+    if (isPoweredOn) {
+      isPoweredOn = false;
+      report.powerMillis += power_off_time;
+    }
+  }
+
+
+  void hibernate() {
+    powerOff();
+  }
+
+ private:
+  uint32_t spiClockHz = 4000000;
+  bool isPoweredOn = false;
+  std::vector<WindowWrite> windowWrites;
+  CycleReport report;
+
+
+  void powerOnIfRequired() {
+    if (!isPoweredOn) {
+      isPoweredOn = true;
+      ++report.powerCycleCount;
+      report.powerMillis += power_on_time;
+    }
+  }
+};
@@ -10,28 +10,51 @@
 // - Implement calibration function using the four push buttons.
 
 
+#include <atomic>
 #include <cstdint>
+#include <numeric>
 
 #include <vector>
 
 #include <WiFi.h>  // Platform 'esp32' by Espressif (here V2.0.11)
+#include <WiFiClientSecure.h>
 #include <time.h>
 #include <HTTPClient.h>
+#include <Preferences.h>
+#include <WebServer.h>
 
 #include <ArduinoJson.h>  // Library 'ArduinoJson' by Benoit Blanchon (here V7.2.0)
 
 #include <GxEPD2_3C.h>  // Library 'GxEPD2' by Jean-Marc Zingg (here V1.6.0).
 
 #include <U8g2_for_Adafruit_GFX.h>  // Library 'U8g2_for_Adafruit_GFX' by oliver (here V1.8.0)
-#include <Fonts/FreeSans9pt7b.h>
-#include <Fonts/FreeSans12pt7b.h>
-#include <Fonts/FreeSansBold24pt7b.h>
 
+#include "anomaly_detector.h"
+#include "boxle_config.h"
+#include "clear_sky_model.h"
+#include "daily_yield.h"
+#include "data_quality.h"
+#include "frame_renderer.h"
+#include "gauge_backend.h"
+#include "input_shaper.h"
+#include "logger.h"
+#include "pac_forecaster.h"
 #include "plot_utility.h"
-#include "secrets.h"  // Define WIFI_SSID, WIFI_PASSWORD, and THINGSPEAK_CHANNEL in this file.
+#include "pv_data.h"
+#include "time_ticks.h"
+#include "tri_color_frame_buffer.h"
+#include "waveform_generator.h"
+#include "secrets.h"  // Define default WIFI_SSID, WIFI_PASSWORD, and THINGSPEAK_CHANNEL (or THINGSPEAK_CHANNELS) and the CONFIG_PIN in this file.
 
 
-TaskHandle_t longRunningFunctionsTask;
+TaskHandle_t longRunningFunctionsTask = NULL;
+
+// All tasks log into a lock-free ring buffer (cf. logger.h), which is
+// written to Serial by a low-priority task. Hence, a full UART FIFO never
+// stalls the ammeter or the rendering. Set LOG_LEVEL to LOG_LEVEL_DEBUG
+// before including logger.h for verbose output.
+const int LOG_OUTPUT_INTERVAL_MS = 20;
+TaskHandle_t logOutputTask = NULL;
 
 const int AMMETER_PIN = 26;
 
@@ -45,43 +68,314 @@ const int E_PAPER_DC = 25;
 const int E_PAPER_RST = 33;
 const int E_PAPER_BUSY = 12;
 
-GxEPD2_3C<GxEPD2_583c_Z83, GxEPD2_583c_Z83::HEIGHT>* displayPtr;
+// Use a simulated panel instead of the real one. It models the time the
+// panel is busy with transfers and refreshes, e.g., to compare refresh
+// strategies in replay mode.
+#define HAS_SIMULATED_PANEL false
+#if HAS_SIMULATED_PANEL
+  #include "simulated_panel.h"
+  typedef SimulatedPanel<GxEPD2_583c_Z83> BoxlePanel;
+#else
+  typedef GxEPD2_583c_Z83 BoxlePanel;
+#endif
+
+TriColorDisplay<BoxlePanel>* displayPtr;
+
+// Write the planes to the panel by DMA instead of byte by byte through
+// GxEPD2. The SPI clock is the same as the one used by GxEPD2.
+#define HAS_DMA_FRAME_TRANSFER false
+#if HAS_DMA_FRAME_TRANSFER && !HAS_SIMULATED_PANEL
+  #include "dma_panel_writer.h"
+  DmaPanelWriter dmaPanelWriter(SPI3_HOST, 18, 23, E_PAPER_CS, E_PAPER_DC, 4000000);
+  std::atomic<unsigned long> dmaWriteMicros(0);  // Sum of the DMA transfers of the current frame.
+#endif
+
+// Number of bands the screen is rendered in. Each band is written to the
+// panel on core 1 (by DMA or by GxEPD2) while the next one is rendered on
+// core 0. A single band disables this pipeline. Note that the whole frame
+// is drawn for each band (and clipped to it), i.e., the rendering costs
+// about PIPELINED_BAND_COUNT times the CPU time of a single page.
+const int PIPELINED_BAND_COUNT = 4;
 
 #define NTP_SERVER "de.pool.ntp.org"
 
-const int MAX_ZOOM = 6;
-const std::array<int, MAX_ZOOM + 1> ZOOM_TO_RESOLUTION_MINUTES{ 10,   20,       30,       60,       60,       240,       720};
-const std::array<int, MAX_ZOOM + 1> ZOOM_TO_RANGE_MINUTES{     720, 1440, 2 * 2440, 4 * 1440, 8 * 1440, 16 * 1440, 32 * 1440};
 
 
 U8G2_FOR_ADAFRUIT_GFX u8g2Fonts;
 
+// Renderer of the e-Ink display, which caches the ticks of the time axes
+// between redraws.
+FrameRenderer frameRenderer;
+
+// Daily yields of the last days and the configuration, persisted in the NVS.
+DailyYieldHistory dailyYieldHistory;
+Preferences preferences;
+BoxleConfigStore configStore(preferences);
+
+// Configuration loaded once at boot. Changes via the web server are saved
+// in the NVS and take effect after a restart. Only the step response times
+// of the ammeter may be measured at runtime. They are kept in
+// ammeterStepResponseMillis (cf. getCurrentConfig). All reads of the
+// configuration by the web server and all saves are guarded by configMutex.
+BoxleConfig loadedConfig;
+const BoxleConfig& config = loadedConfig;
+SemaphoreHandle_t configMutex = NULL;
+
+// Changes via the web server require this PIN, to be defined in secrets.h.
+// Without a PIN, the configuration can only be viewed. After a wrong PIN,
+// all changes are rejected for CONFIG_PIN_LOCKOUT_MS. Holding push button A
+// at boot resets the configuration to the defaults of secrets.h, e.g.,
+// after a typo in the WiFi credentials.
+#ifndef CONFIG_PIN
+  #define CONFIG_PIN ""
+#endif
+const unsigned long CONFIG_PIN_LOCKOUT_MS = 5000;
+unsigned long configPinLockoutStartMillis = 0;
+bool isConfigPinLockedOut = false;
+
+WebServer webServer(80);
+bool isWebServerStarted = false;
+
 SemaphoreHandle_t globalMutex = NULL;
 int zoom = 3;
 bool isNtpInitialized = false;
 
 
-#define HAS_STEPPER_AS_AMMETER false
-#if HAS_STEPPER_AS_AMMETER
+// In replay mode, the data is not queried from ThingSpeak but taken from
+// recorded feeds on the LittleFS, one file /replay/<channel id>.json per
+// channel, with a virtual clock running REPLAY_SPEEDUP times faster than
+// real time. No WiFi is required. This allows to profile the whole
+// pipeline (caching, decimation, rendering) deterministically. Each frame
+// is timed and optionally dumped to /replay/frame_<n>.bin. If a golden
+// frame /replay/golden_<n>.bin exists (e.g., a reviewed dump), the frame is
+// compared with it pixel by pixel to detect visual changes of the renderer.
+// The CRCs of the frames are compared with /replay/golden_crcs.txt (one
+// hexadecimal CRC per line) if it exists, e.g., the CRCs logged by a
+// reviewed replay. On the host, test/frame_render_test.cpp checks the
+// renderer against golden CRCs without the box.
+#define HAS_REPLAY_MODE false
+#if HAS_REPLAY_MODE
+  #include <LittleFS.h>
+  #include <rom/crc.h>
+  #include "feed_replay.h"
+  #include "frame_diff.h"
+  const long REPLAY_SPEEDUP = 1000;
+  const int REPLAY_DUMPED_FRAME_COUNT = 0;  // Mind the size of the LittleFS, each frame takes 76 kB.
+  FeedReplay feedReplay;
+#endif
+
+
+/// Durations of the rendering and of the transfer and refresh of the last
+/// frame. The busy time of the panel is only known for the simulated panel.
+struct FrameTiming {
+  unsigned long renderMicros = 0;
+  unsigned long transferMicros = 0;
+  uint32_t panelBusyMillis = 0;
+};
+
+FrameTiming lastFrameTiming;
+
+
+// Backend of the analog display: a moving-coil meter driven by PWM, a
+// hobby servo, or a stepper motor with step/direction driver. The motors
+// follow a trapezoidal motion profile (full scale per second, full scale
+// per second squared).
+#define AMMETER_BACKEND_PWM 0
+#define AMMETER_BACKEND_SERVO 1
+#define AMMETER_BACKEND_STEPPER 2
+#define AMMETER_BACKEND AMMETER_BACKEND_PWM
+#if AMMETER_BACKEND == AMMETER_BACKEND_SERVO
   #include <ESP32Servo.h>  // Library 'ESP32Servo' V3.0.6 by Kevin Harrington, John K. Bennett.
-  Servo ammeterServo;
+  ServoGauge<Servo> ammeterGauge(AMMETER_PIN, 0, 90, MotionProfile(1.0f, 4.0f));
+#elif AMMETER_BACKEND == AMMETER_BACKEND_STEPPER
+  const int AMMETER_DIRECTION_PIN = 27;
+  StepperGauge ammeterGauge(AMMETER_PIN, AMMETER_DIRECTION_PIN, 800, MotionProfile(1.0f, 4.0f));
+#else
+  PwmGauge ammeterGauge(AMMETER_PIN);
 #endif
 
 
-/// Struct for a single data item from the photovoltaic system. 
-struct PVSingleData {
-  double age = 0.0;
-  float pAC = 0.0f;
-  float uAC = 0.0f;
-  float frequency = 0.0f;
-  float temperature = 0.0f;
-  float efficiency = 0.0f;
-  float totalYield = 0.0f;  
+/// Quantity shown by the analog display with its linear mapping to the
+/// needle position (0 to 1). The factor is precomputed from the range.
+struct GaugeMode {
+  const char* label;
+  PVField field;  // Shown field of the photovoltaic data.
+  float zeroValue;  // Value at the left end.
+  float factor;  // Position per unit, i.e., 1 / (full scale value - zeroValue).
+
+  GaugeMode(const char* label, PVField field, float zeroValue, float fullScaleValue)
+  : label(label), field(field), zeroValue(zeroValue), factor(1.0f / (fullScaleValue - zeroValue)) {}
+
+  float getPosition(float value) const {
+    return (value - zeroValue) * factor;
+  }
 };
 
+// Gauge modes cycled by push button A: P_AC, deviation of the grid
+// frequency around 50 Hz and of U_AC around 230 V, and today's yield
+// relative to DAILY_YIELD_TARGET_KWH (at full scale). Filled in setup()
+// since the full scale of P_AC is configurable.
+enum GaugeModeIndex {GAUGE_MODE_PAC, GAUGE_MODE_FREQUENCY, GAUGE_MODE_UAC, GAUGE_MODE_DAILY_YIELD, GAUGE_MODE_COUNT};
+const float DAILY_YIELD_TARGET_KWH = 4.0f;
+std::vector<GaugeMode> gaugeModes;
+std::atomic<int> gaugeModeIndex{GAUGE_MODE_PAC};
+
+// Between two updates, the gauge may show a forecast of P_AC instead of
+// holding the last value. The forecaster is fed with each new P_AC and
+// guarded by globalMutex. In replay mode, its error is backtested against
+// the recorded feeds, also if the forecast is not shown. Disabled by
+// default since the backtest on the reference feed (cf.
+// test/pac_forecast_backtest.cpp) shows no gain over holding the value at
+// 180 s updates (MAE 7.3 W vs 7.4 W, RMSE 12.4 W vs 12.3 W).
+#define HAS_PAC_FORECAST false
+PacForecaster pacForecaster;
+
+// Location (degrees, north and east positive), orientation of the panels
+// (tilt from horizontal and azimuth from north in degrees), and peak power
+// of the photovoltaic system for the clear-sky model. Override them in
+// secrets.h. With several channels, define PV_PEAK_WATTS as comma-separated
+// list of the peak power of each channel in the order of the channels
+// (e.g., 780.0f, 420.0f), since the model is compared with the sum of
+// them. The expected production under a clear sky is drawn as dotted
+// reference curve into the P_AC plot. If PV_PEAK_WATTS is defined, it also
+// limits the rise of the forecast of P_AC by CLEAR_SKY_FORECAST_MARGIN
+// (clouds may raise the production for a short time). The model is
+// computed once per day, guarded by globalMutex.
+#ifndef PV_LATITUDE
+  #define PV_LATITUDE 48.78f
+#endif
+#ifndef PV_LONGITUDE
+  #define PV_LONGITUDE 9.18f
+#endif
+#ifndef PV_TILT_DEGREES
+  #define PV_TILT_DEGREES 30.0f
+#endif
+#ifndef PV_AZIMUTH_DEGREES
+  #define PV_AZIMUTH_DEGREES 180.0f
+#endif
+#ifdef PV_PEAK_WATTS
+  #define HAS_CONFIGURED_PV_PEAK_WATTS true
+#else
+  #define HAS_CONFIGURED_PV_PEAK_WATTS false
+  #define PV_PEAK_WATTS 800.0f
+#endif
+const std::vector<float> PV_PEAK_WATTS_PER_CHANNEL{PV_PEAK_WATTS};
+const float CLEAR_SKY_FORECAST_MARGIN = 1.2f;
+ClearSkyModel clearSkyModel(PV_LATITUDE, PV_LONGITUDE, PV_TILT_DEGREES, PV_AZIMUTH_DEGREES,
+                            std::accumulate(PV_PEAK_WATTS_PER_CHANNEL.begin(), PV_PEAK_WATTS_PER_CHANNEL.end(), 0.0f));
+
+// Streaming anomaly detection on the grid frequency and voltage, fed with
+// all entries of the first channel since the last check, at most for the
+// last ANOMALY_CHECK_MAX_SECONDS (e.g., after the boot). The fixed limits
+// are the normal operating band of the frequency in the European grid and
+// the tolerance of +/- 10 % of the nominal voltage (EN 50160). The events
+// are persisted in the NVS and marked in the plots (cf. AnomalySource).
+StreamingAnomalyDetector frequencyAnomalyDetector(49.8f, 50.2f, 0.05f, 4.0f, 0.01f, 20);
+StreamingAnomalyDetector uacAnomalyDetector(207.0f, 253.0f, 0.05f, 4.0f, 0.5f, 20);
+AnomalyEventLog anomalyLog;
+time_t lastAnomalyCheckTimestamp = 0;
+const long ANOMALY_CHECK_MAX_SECONDS = 3600;
+
+// Holding push button A longer than this shows a test signal instead of
+// changing the gauge mode on release.
+const unsigned long LONG_PRESS_MS = 1000;
+
+// Held push buttons are logged at most once per this interval.
+const unsigned long BUTTON_LOG_INTERVAL_MS = 1000;
+
+// The active gauge mode is indicated in the top left corner of the e-paper
+// display. On a change, only this area is refreshed.
+int shownGaugeModeIndex = GAUGE_MODE_PAC;
+
+
+// The ammeter is driven by a dedicated task woken by a hardware timer every
+// AMMETER_UPDATE_INTERVAL_MS, independent of the push buttons and logging.
+// The target value (0 to 255) is passed by a single atomic word, i.e., a
+// lock-free mailbox in which only the newest value matters.
+const int AMMETER_UPDATE_INTERVAL_MS = 20;
+std::atomic<int> ammeterTargetValue{0};
+TaskHandle_t ammeterOutputTask = NULL;
+hw_timer_t* ammeterTimer = NULL;
+
+// Test signal shown while push button A is held, generated by the ammeter
+// output task at its update rate, cf. tools/analog_out_sinus.
+const WaveformGenerator::Shape TEST_SIGNAL_SHAPE = WaveformGenerator::Shape::SINE;
+const float TEST_SIGNAL_FREQUENCY_HZ = 0.25f;
+WaveformGenerator testSignal(1000 / AMMETER_UPDATE_INTERVAL_MS);
+std::atomic<bool> isTestSignalActive{false};
+
+// The ammeter output is shaped by a ZV input shaper against the overshoot of
+// the needle, based on the step response times from the configuration. The
+// times are packed into one atomic word (peak time in the upper 16 bits,
+// settling time in the lower 16 bits), where 0 disables the shaping.
+// Holding push button D starts the characterization of the step response,
+// in which push button B marks the first peak and push button C the
+// settled needle. Both only apply to the moving-coil meter, as the motors
+// follow their own motion profile.
+#define HAS_AMMETER_SHAPING (AMMETER_BACKEND == AMMETER_BACKEND_PWM)
+ZeroVibrationShaper ammeterShaper;
+std::atomic<uint32_t> ammeterStepResponseMillis{0};
+StepResponseCharacterization ammeterCharacterization;
+
+
+// Combination of the newest data of all channels.
 PVSingleData newestData; 
 
 
+// Define THINGSPEAK_CHANNELS as comma-separated list of channel IDs in
+// secrets.h to show the data of several inverters on one box. The channels
+// may also be changed at runtime via the configuration.
+#ifndef THINGSPEAK_CHANNELS
+  #define THINGSPEAK_CHANNELS THINGSPEAK_CHANNEL
+#endif
+
+
+/// Struct for the cached data of one ThingSpeak channel (i.e., inverter). The
+/// curves use absolute timestamps as x values so that they can be reused as
+/// long as the channel does not receive new data.
+struct PVChannel {
+  String id;
+  PVSingleData newestData;
+  int curvesZoom = -1;
+  time_t curvesTimestamp = 0;
+  std::vector<PlotPoint> pacCurve;
+  std::vector<PlotPoint> uacCurve;
+  std::vector<PlotPoint> frequencyCurve;
+};
+
+std::vector<PVChannel> channels;
+
+
+/// Returns the default configuration based on secrets.h.
+BoxleConfig getDefaultConfig() {
+  BoxleConfig defaults;
+  BoxleConfigStore::setString(defaults.wifiSsid, WIFI_SSID);
+  BoxleConfigStore::setString(defaults.wifiPassword, WIFI_PASSWORD);
+  String channelList;
+  for (const String& channelId : std::vector<String>{THINGSPEAK_CHANNELS}) {
+    if (channelList.length() > 0) {
+      channelList += ",";
+    }
+    channelList += channelId;
+  }
+  BoxleConfigStore::setString(defaults.thingSpeakChannels, channelList.c_str());
+  defaults.maxDataAgeSeconds = 900;
+  defaults.redrawIntervalSeconds = 180;
+  defaults.ammeterFullScaleWatts = 1000;
+  defaults.pacReferenceWatts = 600;
+  defaults.pacPlotMaxWatts = 0;
+  defaults.ammeterPeakMillis = 0;
+  defaults.ammeterSettlingMillis = 0;
+  return defaults;
+}
+
+
+// All queries go through one HTTP client, which keeps the connection to
+// ThingSpeak alive between the requests.
+WiFiClientSecure thingSpeakClient;
+HTTPClient thingSpeakHttp;
+
+
 /// Waits up to the given number of milliseconds for the WiFi to connect.
 void waitUntilWiFiConnectedOrTimeout(long timeout_ms) {
   assert(timeout_ms >= 5000);
@@ -97,21 +391,19 @@ void waitUntilWiFiConnectedOrTimeout(long timeout_ms) {
 /// Tries to connect to WiFi the given number of times.
 bool tryConnectWiFi(size_t attemps) {
   size_t index = 0;
-  Serial.print(F("Connecting to WiFi ."));
+  LOG_INFO("Connecting to WiFi ...");
   while(WiFi.status() != WL_CONNECTED && index < attemps) {
     index++;
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    Serial.print(".");
+    WiFi.begin(config.wifiSsid, config.wifiPassword);
     waitUntilWiFiConnectedOrTimeout(5000);
   } 
-  Serial.println("");
   
   if (WiFi.status() != WL_CONNECTED) {
-    Serial.println(F("Could not connect to WiFi."));
+    LOG_WARNING("Could not connect to WiFi.");
     return false;
   }
 
-  Serial.println(F("Connected to WiFi successfully."));
+  LOG_INFO("Connected to WiFi successfully.");
   return true;
 }
 
@@ -119,123 +411,414 @@ bool tryConnectWiFi(size_t attemps) {
 /// Sends the given HTTP request and returns the response - or an empty
 /// string if the request failed.
 String tryHTTPRequest(const String& url, size_t attempts) {
-  Serial.print(F("Sending HTTP request to "));
-  Serial.print(url);
-  Serial.println(".");
+  LOG_DEBUG("Sending HTTP request to %s.", url.c_str());
   
   int response = -1;
   String content = "";
   size_t index = 0;
   do {
     index++;
-    HTTPClient http;
-    http.begin(url.c_str());
-    response = http.GET();
-    content = http.getString();
-    http.end();
+    thingSpeakHttp.begin(thingSpeakClient, url);
+    response = thingSpeakHttp.GET();
+    content = thingSpeakHttp.getString();
+    thingSpeakHttp.end();
   } while(response != 200 && index < attempts);
   
   if (response != 200) {
-    Serial.print(F("Problem with REST query: HTTP error code is "));
-    Serial.println(response);
+    LOG_WARNING("Problem with REST query: HTTP error code is %d.", response);
     return String("");
   }
   
-  Serial.println(F("REST query successful."));
+  LOG_DEBUG("REST query successful.");
   return content;
 }
 
 
-/// Queries the newest/latest data from the ThingSpeak channel. The argument
-/// currentTime is used to determine the relative age of the data.
-void queryNewestData(tm& currentTime) {
-  String url = "https://api.thingspeak.com/channels/" + String(THINGSPEAK_CHANNEL) + "/feeds.json?results=1";
-  String content = tryHTTPRequest(url, 5);
+/// Sends the given request to ThingSpeak and returns the response - or an
+/// empty string if the request failed. In replay mode, the request is
+/// answered from the recorded feeds at the virtual time.
+String queryThingSpeak(const String& url) {
+#if HAS_REPLAY_MODE
+  return feedReplay.handleRequest(url);
+#else
+  return tryHTTPRequest(url, 5);
+#endif
+}
+
+
+// Task currently waiting in waitWhilePanelBusy, i.e., the long-running task
+// (e.g., during the refresh) or the band transfer task of the display.
+volatile TaskHandle_t panelBusyWaitingTask = NULL;
+
+
+/// Notifies the task waiting for the e-paper panel on each change of its
+/// BUSY line.
+void IRAM_ATTR onPanelBusyChanged() {
+  TaskHandle_t waitingTask = panelBusyWaitingTask;
+  if (waitingTask != NULL) {
+    BaseType_t isHigherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(waitingTask, &isHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(isHigherPriorityTaskWoken);
+  }
+}
+
+
+/// Called repeatedly by GxEPD2 while the panel is busy (e.g., during the
+/// refresh of about 15 seconds) instead of polling the BUSY line every
+/// millisecond. It sleeps until the BUSY line changes, at most for
+/// PANEL_BUSY_SLEEP_MS. In the long-running task, it serves the web server
+/// before, but not in the band transfer task with its small stack.
+void waitWhilePanelBusy(const void*) {
+  const TickType_t PANEL_BUSY_SLEEP_MS = 50;
+  TaskHandle_t currentTask = xTaskGetCurrentTaskHandle();
+  if (isWebServerStarted && currentTask == longRunningFunctionsTask) {
+    webServer.handleClient();
+  }
+  panelBusyWaitingTask = currentTask;
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PANEL_BUSY_SLEEP_MS));
+  panelBusyWaitingTask = NULL;
+}
+
+
+/// Returns the current time, which is the virtual time in replay mode.
+bool getCurrentTime(tm& currentTime) {
+#if HAS_REPLAY_MODE
+  time_t now = feedReplay.getNow();
+  gmtime_r(&now, &currentTime);
+  return true;
+#else
+  return getLocalTime(&currentTime, 10000);
+#endif
+}
+
+
+/// Returns the current time as timestamp without waiting for NTP, which is
+/// the virtual time in replay mode.
+time_t getCurrentTimestamp() {
+#if HAS_REPLAY_MODE
+  return feedReplay.getNow();
+#else
+  return time(nullptr);
+#endif
+}
+
+
+/// Escapes the given text for use in HTML attributes.
+String escapeHtml(const String& text) {
+  String result;
+  for (size_t index = 0; index < text.length(); ++index) {
+    char c = text[index];
+    if (c == '&') {
+      result += "&amp;";
+    } else if (c == '<') {
+      result += "&lt;";
+    } else if (c == '>') {
+      result += "&gt;";
+    } else if (c == '\'' || c == '"') {
+      result += "&#" + String(static_cast<int>(c)) + ";";
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+
+/// Returns the given step response times packed for the ammeter output task.
+uint32_t packStepResponseMillis(uint16_t peakMillis, uint16_t settlingMillis) {
+  return (static_cast<uint32_t>(peakMillis) << 16) | settlingMillis;
+}
+
+
+/// Returns a copy of the configuration with the step response times of the
+/// ammeter currently in use, which may have been measured since the boot.
+/// During a characterization (i.e., without shaping), the times of the
+/// configuration are kept. Must be called with configMutex taken.
+BoxleConfig getCurrentConfig() {
+  BoxleConfig currentConfig = config;
+  uint32_t stepResponseMillis = ammeterStepResponseMillis.load();
+  if (stepResponseMillis != 0) {
+    currentConfig.ammeterPeakMillis = static_cast<uint16_t>(stepResponseMillis >> 16);
+    currentConfig.ammeterSettlingMillis = static_cast<uint16_t>(stepResponseMillis & 0xFFFF);
+  }
+  return currentConfig;
+}
+
+
+/// Serves a form to edit the configuration. The WiFi password is never
+/// sent; leaving it empty keeps the current one.
+void handleConfigGet() {
+  xSemaphoreTake(configMutex, portMAX_DELAY);
+  BoxleConfig currentConfig = getCurrentConfig();
+  xSemaphoreGive(configMutex);
+  bool isChangeable = (strlen(CONFIG_PIN) > 0);
+  String html = F("<!DOCTYPE html><html><head><meta charset='utf-8'><title>Smart Home B&ouml;xle</title></head><body>"
+                  "<h1>Smart Home B&ouml;xle</h1><form method='post' action='/config'><table>");
+  html += "<tr><td>WiFi SSID</td><td><input name='wifiSsid' value='" + escapeHtml(currentConfig.wifiSsid) + "'></td></tr>";
+  html += F("<tr><td>WiFi password</td><td><input name='wifiPassword' type='password' placeholder='unchanged'></td></tr>");
+  html += "<tr><td>ThingSpeak channels</td><td><input name='thingSpeakChannels' value='" + escapeHtml(currentConfig.thingSpeakChannels) + "'></td></tr>";
+  for (const BoxleConfigField& field : BOXLE_CONFIG_FIELDS) {
+    html += "<tr><td>" + String(field.label) + "</td><td><input name='" + String(field.name) + "' type='number' min='" + String(field.minValue)
+         + "' max='" + String(field.maxValue) + "' value='" + String(currentConfig.*field.member) + "'></td></tr>";
+  }
+  if (isChangeable) {
+    html += F("<tr><td>PIN</td><td><input name='pin' type='password'></td></tr>"
+              "</table><input type='submit' value='Save and restart'></form></body></html>");
+  } else {
+    html += F("</table><p>Define CONFIG_PIN in secrets.h to change the configuration here.</p></form></body></html>");
+  }
+  webServer.send(200, "text/html", html);
+}
+
+
+/// Validates and saves the posted configuration and restarts the box.
+void handleConfigPost() {
+  if (isConfigPinLockedOut && millis() - configPinLockoutStartMillis < CONFIG_PIN_LOCKOUT_MS) {
+    webServer.send(429, "text/plain", "Too many attempts, try again later.");
+    return;
+  }
+  isConfigPinLockedOut = false;
+  if (strlen(CONFIG_PIN) == 0) {
+    webServer.send(403, "text/plain", "Define CONFIG_PIN in secrets.h to change the configuration.");
+    return;
+  }
+  if (!webServer.hasArg("pin") || webServer.arg("pin") != CONFIG_PIN) {
+    isConfigPinLockedOut = true;
+    configPinLockoutStartMillis = millis();
+    LOG_WARNING("Configuration change with wrong PIN from %s rejected.", webServer.client().remoteIP().toString().c_str());
+    webServer.send(403, "text/plain", "Wrong PIN.");
+    return;
+  }
+
+  xSemaphoreTake(configMutex, portMAX_DELAY);
+  BoxleConfig newConfig = getCurrentConfig();
+  if (webServer.hasArg("wifiSsid")) {
+    BoxleConfigStore::setString(newConfig.wifiSsid, webServer.arg("wifiSsid").c_str());
+  }
+  if (webServer.hasArg("wifiPassword") && webServer.arg("wifiPassword").length() > 0) {
+    BoxleConfigStore::setString(newConfig.wifiPassword, webServer.arg("wifiPassword").c_str());
+  }
+  if (webServer.hasArg("thingSpeakChannels")) {
+    BoxleConfigStore::setString(newConfig.thingSpeakChannels, webServer.arg("thingSpeakChannels").c_str());
+  }
+  for (const BoxleConfigField& field : BOXLE_CONFIG_FIELDS) {
+    if (!webServer.hasArg(field.name)) {
+      continue;
+    }
+    long value = webServer.arg(field.name).toInt();
+    if (value < field.minValue || value > field.maxValue) {
+      xSemaphoreGive(configMutex);
+      webServer.send(400, "text/plain", "Invalid value for " + String(field.label) + ".");
+      return;
+    }
+    newConfig.*field.member = static_cast<uint16_t>(value);
+  }
+
+  bool isSaved = configStore.save(newConfig);
+  xSemaphoreGive(configMutex);
+  if (!isSaved) {
+    webServer.send(500, "text/plain", "Could not save configuration.");
+    return;
+  }
+  webServer.send(200, "text/plain", "Configuration saved. Restarting ...");
+  LOG_INFO("Configuration changed, restarting.");
+  delay(1000);
+  ESP.restart();
+}
+
+
+/// Queries the newest/latest data from the given ThingSpeak channel. The
+/// argument currentTime is used to determine the relative age of the data.
+void queryNewestData(PVChannel& channel, tm& currentTime) {
+  String url = "https://api.thingspeak.com/channels/" + channel.id + "/feeds.json?results=1";
+  String content = queryThingSpeak(url);
   DynamicJsonDocument doc(10 * 1024);
   DeserializationError errorMsg = deserializeJson(doc, content.c_str());
   if (errorMsg) {
-    Serial.print(F("JSON deserialization failed: "));
-    Serial.println(errorMsg.f_str());
+    LOG_ERROR("JSON deserialization failed: %s", errorMsg.c_str());
     return;
   }
   if (doc["feeds"].size() == 0) {
-    Serial.println(F("Feed is empty!"));
+    LOG_WARNING("Feed is empty!");
     return;
   }
 
   tm timestamp;
   strptime(doc["feeds"][0]["created_at"], "%Y-%m-%dT%H:%M:%SZ", &timestamp);
 
-  xSemaphoreTake(globalMutex, 10 * portTICK_PERIOD_MS);
-  newestData.age = static_cast<double>(difftime(mktime(&currentTime), mktime(&timestamp)));
-  newestData.pAC = doc["feeds"][0]["field3"];
-  newestData.uAC = doc["feeds"][0]["field1"];
-  newestData.frequency = doc["feeds"][0]["field2"];
-  newestData.temperature = doc["feeds"][0]["field4"];
-  newestData.efficiency = doc["feeds"][0]["field5"];
-  newestData.totalYield = doc["feeds"][0]["field6"];
-  xSemaphoreGive(globalMutex); 
+  channel.newestData.timestamp = mktime(&timestamp);
+  channel.newestData.age = static_cast<double>(difftime(mktime(&currentTime), channel.newestData.timestamp));
+  channel.newestData.pAC = getFeedValue(doc["feeds"][0]["field3"]);
+  channel.newestData.uAC = getFeedValue(doc["feeds"][0]["field1"]);
+  channel.newestData.frequency = getFeedValue(doc["feeds"][0]["field2"]);
+  channel.newestData.temperature = getFeedValue(doc["feeds"][0]["field4"]);
+  channel.newestData.efficiency = getFeedValue(doc["feeds"][0]["field5"]);
+  channel.newestData.totalYield = getFeedValue(doc["feeds"][0]["field6"]);
+  channel.newestData.assessQuality(config.maxDataAgeSeconds);
 }
 
 
-/// Queries a timeseries/curve for the given field from the ThingSpeak channel.
-/// The currentTime is used to determine the relative age of each data point.
-/// The argument zoom determines the temporal resolution.
-std::vector<PlotPoint> queryCurveGeneric(tm& currentTime, int zoom, int field) {
+/// Returns the value of the given field of a feed, or NaN if it is missing.
+float getFeedValue(JsonVariantConst value) {
+  return value.isNull() ? NAN : value.as<float>();
+}
+
+
+/// Combines the newest data of all channels, cf. combinePVData. Today's
+/// yield is taken over from newestData, which is written by this task only.
+PVSingleData combineNewestData() {
+  std::vector<PVSingleData> channelData;
+  for (const PVChannel& channel : channels) {
+    channelData.push_back(channel.newestData);
+  }
+  return combinePVData(channelData, newestData.todayYield, config.maxDataAgeSeconds);
+}
+
+
+/// Queries a timeseries/curve for the given field from the given ThingSpeak
+/// channel with the timestamps (seconds since epoch) as x values. The
+/// argument zoom determines the temporal range, the argument
+/// resolutionMinutes the temporal resolution. Missing values are returned
+/// as NaN. If isZeroMissing is set, zero values are considered as missing,
+/// too.
+std::vector<PlotPoint> queryCurveGeneric(const String& channelId, int zoom, int resolutionMinutes, int field, bool isZeroMissing) {
   String fieldAsString(field);
-  String url = "https://api.thingspeak.com/channels/" + String(THINGSPEAK_CHANNEL) + "/fields/" + fieldAsString + ".json?median=" + String(ZOOM_TO_RESOLUTION_MINUTES[zoom]) + "&minutes=" + String(ZOOM_TO_RANGE_MINUTES[zoom]);
-  String content = tryHTTPRequest(url, 5);
+  String url = "https://api.thingspeak.com/channels/" + channelId + "/fields/" + fieldAsString + ".json?median=" + String(resolutionMinutes) + "&minutes=" + String(ZOOM_TO_RANGE_MINUTES[zoom]);
+  String content = queryThingSpeak(url);
   DynamicJsonDocument doc(50 * 1024);
   DeserializationError errorMsg = deserializeJson(doc, content.c_str());
   if (errorMsg) {
-    Serial.print(F("JSON deserialization failed: "));
-    Serial.println(errorMsg.f_str());
+    LOG_ERROR("JSON deserialization failed: %s", errorMsg.c_str());
     return std::vector<PlotPoint>();
   }
   
   std::vector<PlotPoint> result;
   result.reserve(200);
   for (size_t index = 0; index < doc["feeds"].size(); ++index) {
-    double pac = doc["feeds"][index]["field" + fieldAsString];
+    JsonVariant value = doc["feeds"][index]["field" + fieldAsString];
+    double y = value.isNull() ? NAN : value.as<double>();
+    if (isZeroMissing && y == 0.0) {
+      y = NAN;
+    }
     tm timestamp;
     strptime(doc["feeds"][index]["created_at"], "%Y-%m-%dT%H:%M:%SZ", &timestamp);
-    double relativeTime = static_cast<double>(difftime(mktime(&timestamp), mktime(&currentTime)));
-    result.push_back({relativeTime, pac});
+    result.push_back({static_cast<double>(mktime(&timestamp)), y});
   }
   
   return result;
 }
 
 
-/// Queries the P_AC timeseries/curve from the ThingSpeak channel. The
-/// currentTime is used to determine the relative age of each data point.
-/// The argument zoom determines the temporal resolution.
-std::vector<PlotPoint> queryPACCurve(tm& currentTime, int zoom) {
-  return queryCurveGeneric(currentTime, zoom, 3);
+/// Queries the P_AC timeseries/curve from the given ThingSpeak channel. The
+/// argument zoom determines the temporal resolution, which is finer than for
+/// the other curves for envelope zoom levels.
+std::vector<PlotPoint> queryPACCurve(const String& channelId, int zoom) {
+  return queryCurveGeneric(channelId, zoom, getPACResolutionMinutes(zoom), 3, false);
+}
+
+
+/// Queries the frequency timeseries/curve from the given ThingSpeak channel.
+/// The argument zoom determines the temporal resolution. The inverter
+/// reports zero when offline, which is treated as missing value.
+std::vector<PlotPoint> queryFrequencyCurve(const String& channelId, int zoom) {
+  return queryCurveGeneric(channelId, zoom, ZOOM_TO_RESOLUTION_MINUTES[zoom], 2, true);
 }
 
 
-/// Queries the frequency timeseries/curve from the ThingSpeak channel. The
-/// currentTime is used to determine the relative age of each data point.
-/// The argument zoom determines the temporal resolution.
-std::vector<PlotPoint> queryFrequencyCurve(tm& currentTime, int zoom) {
-  return queryCurveGeneric(currentTime, zoom, 2);
+/// Queries the U_AC timeseries/curve from the given ThingSpeak channel. The
+/// argument zoom determines the temporal resolution. The inverter reports
+/// zero when offline, which is treated as missing value.
+std::vector<PlotPoint> queryUACCurve(const String& channelId, int zoom) {
+  return queryCurveGeneric(channelId, zoom, ZOOM_TO_RESOLUTION_MINUTES[zoom], 1, true);
+}
+
+
+/// Updates the cached curves of the given channel for the given zoom level
+/// unless the channel has not received any new data since the last update.
+/// The grid curves (U_AC and frequency) are only queried if requested.
+void updateChannelCurves(PVChannel& channel, int zoom, bool isGridCurvesRequired) {
+  if (channel.newestData.timestamp != 0 && channel.curvesTimestamp == channel.newestData.timestamp && channel.curvesZoom == zoom) {
+    LOG_DEBUG("Using cached curves of channel %s.", channel.id.c_str());
+    return;
+  }
+  channel.pacCurve = queryPACCurve(channel.id, zoom);
+  if (isGridCurvesRequired) {
+    channel.uacCurve = queryUACCurve(channel.id, zoom);
+    channel.frequencyCurve = queryFrequencyCurve(channel.id, zoom);
+  }
+  channel.curvesZoom = zoom;
+  channel.curvesTimestamp = channel.newestData.timestamp;
 }
 
 
-/// Queries the U_AC timeseries/curve from the ThingSpeak channel. The
-/// currentTime is used to determine the relative age of each data point.
-/// The argument zoom determines the temporal resolution.
-std::vector<PlotPoint> queryUACCurve(tm& currentTime, int zoom) {
-  return queryCurveGeneric(currentTime, zoom, 1);
+/// Queries all entries of the given channel after lastAnomalyCheckTimestamp
+/// (but at most for ANOMALY_CHECK_MAX_SECONDS before the given time), feeds
+/// their grid frequency and voltage into the anomaly detectors in time
+/// order, and logs the anomalies found. Returns true if an anomaly has been
+/// logged.
+bool checkGridAnomalies(const PVChannel& channel, time_t now) {
+  time_t start = std::max<time_t>(lastAnomalyCheckTimestamp + 1, now - ANOMALY_CHECK_MAX_SECONDS);
+  tm startTime;
+  gmtime_r(&start, &startTime);
+  char startText[32];
+  strftime(startText, sizeof(startText), "%Y-%m-%d%%20%H:%M:%S", &startTime);
+  String url = "https://api.thingspeak.com/channels/" + channel.id + "/feeds.json?start=" + startText;
+  String content = queryThingSpeak(url);
+  JsonDocument filter;
+  filter["feeds"][0]["created_at"] = true;
+  filter["feeds"][0]["field1"] = true;
+  filter["feeds"][0]["field2"] = true;
+  DynamicJsonDocument doc(20 * 1024);
+  DeserializationError errorMsg = deserializeJson(doc, content.c_str(), DeserializationOption::Filter(filter));
+  if (errorMsg) {
+    LOG_ERROR("JSON deserialization failed: %s", errorMsg.c_str());
+    return false;
+  }
+
+  struct Check {
+    AnomalySource source;
+    PVField field;
+    const char* key;
+    StreamingAnomalyDetector& detector;
+    const char* unit;
+  };
+  Check checks[] = {
+    {ANOMALY_SOURCE_FREQUENCY, PV_FIELD_FREQUENCY, "field2", frequencyAnomalyDetector, "Hz"},
+    {ANOMALY_SOURCE_UAC, PV_FIELD_UAC, "field1", uacAnomalyDetector, "V"}
+  };
+  bool isLogged = false;
+  for (JsonVariantConst entry : doc["feeds"].as<JsonArrayConst>()) {
+    tm timestamp;
+    strptime(entry["created_at"], "%Y-%m-%dT%H:%M:%SZ", &timestamp);
+    time_t entryTimestamp = mktime(&timestamp);
+    if (entryTimestamp <= lastAnomalyCheckTimestamp) {
+      continue;
+    }
+    lastAnomalyCheckTimestamp = entryTimestamp;
+    for (Check& check : checks) {
+      float value = getFeedValue(entry[check.key]);
+      if (!DataQualityFlags::isValidValue(check.field, value)) {
+        continue;
+      }
+      AnomalyKind kind = check.detector.addSample(value);
+      if (kind != AnomalyKind::NONE) {
+        anomalyLog.add({static_cast<uint32_t>(entryTimestamp), value, check.source, kind});
+        LOG_WARNING("Grid anomaly (%s): %.2f %s, moving mean %.2f %s.", (kind == AnomalyKind::OUT_OF_RANGE) ? "out of range" : "outlier",
+                    value, check.unit, check.detector.getMean(), check.unit);
+        isLogged = true;
+      }
+    }
+  }
+  return isLogged;
 }
 
 
 /// The main function (static schedule) for all long-running functions
 /// such as querying ThingSpeak and updating the e-Ink display.
 void longRunningFunctionsMain(void*) {
-  WiFiClient client;
   WiFi.mode(WIFI_STA);
+  thingSpeakClient.setInsecure();
+  thingSpeakHttp.setReuse(true);
 
   long nextPlotRedrawMillis = 0;
 
@@ -243,89 +826,408 @@ void longRunningFunctionsMain(void*) {
     if (WiFi.status() != WL_CONNECTED) {
       tryConnectWiFi(5);      
     } else if (!isNtpInitialized) {
-      Serial.println(F("Initializing NTP ..."));
+      LOG_INFO("Initializing NTP ...");
       configTime(0, 0, NTP_SERVER);
       struct tm currentTime;
       if (getLocalTime(&currentTime, 10000)){
-        Serial.println(F("Queried NTP server successfully."));
+        LOG_INFO("Queried NTP server successfully.");
         isNtpInitialized = true;
       } else {
-        Serial.println(F("Could not initialize NTP!"));
+        LOG_WARNING("Could not initialize NTP!");
       }
+    } else if (!isWebServerStarted) {
+      webServer.on("/config", HTTP_GET, handleConfigGet);
+      webServer.on("/config", HTTP_POST, handleConfigPost);
+      webServer.begin();
+      isWebServerStarted = true;
+      LOG_INFO("Configuration available at http://%s/config", WiFi.localIP().toString().c_str());
     } else if (millis() > nextPlotRedrawMillis) {
       queryDataAndRedraw(zoom);
-      nextPlotRedrawMillis = millis() + 180 * 1000;  // Normally do not redraw faster than 3 minutes.
+      nextPlotRedrawMillis = millis() + config.redrawIntervalSeconds * 1000L;  // ThingSpeak is updated only every few minutes anyway.
+    } else if (gaugeModeIndex.load() != shownGaugeModeIndex) {
+      updateGaugeModeIndicator();
+    }
+    if (isWebServerStarted) {
+      webServer.handleClient();
     }
     delay(10);
   }
 
+  // Persist the progress of the anomaly check so that the entries are not
+  // checked and logged again after the restart.
+  preferences.putUInt("anomalyCheck", static_cast<uint32_t>(lastAnomalyCheckTimestamp));
   ESP.restart();
 }
 
 
+#if HAS_REPLAY_MODE
+/// Writes the current frame buffer (black plane followed by red plane, in
+/// the layout of GxEPD2) to the LittleFS.
+void dumpFrame(int frameIndex) {
+  char path[32];
+  snprintf(path, sizeof(path), "/replay/frame_%04d.bin", frameIndex);
+  File file = LittleFS.open(path, "w");
+  if (!file) {
+    LOG_ERROR("Could not create %s", path);
+    return;
+  }
+  file.write(displayPtr->getBlackPlane(), displayPtr->getPlaneSize());
+  file.write(displayPtr->getRedPlane(), displayPtr->getPlaneSize());
+  file.close();
+}
+
+
+/// Compares the current frame buffer with the golden frame of the given
+/// index on the LittleFS and reports the differences. Returns the number of
+/// different pixels or -1 if there is no golden frame.
+long compareWithGoldenFrame(int frameIndex) {
+  char path[32];
+  snprintf(path, sizeof(path), "/replay/golden_%04d.bin", frameIndex);
+  if (!LittleFS.exists(path)) {
+    return -1;
+  }
+  File file = LittleFS.open(path, "r");
+  if (!file || file.size() != 2 * displayPtr->getPlaneSize()) {
+    LOG_WARNING("Golden frame has wrong size: %s", path);
+    return -1;
+  }
+
+  const uint32_t CHUNK_SIZE = 1024;
+  std::vector<uint8_t> chunk(CHUNK_SIZE);
+  FrameDiff blackDiff(GxEPD2_583c_Z83::WIDTH);
+  FrameDiff redDiff(GxEPD2_583c_Z83::WIDTH);
+  for (FrameDiff* diff : {&blackDiff, &redDiff}) {
+    const uint8_t* plane = (diff == &blackDiff) ? displayPtr->getBlackPlane() : displayPtr->getRedPlane();
+    for (uint32_t offset = 0; offset < displayPtr->getPlaneSize(); offset += CHUNK_SIZE) {
+      uint32_t length = std::min<uint32_t>(CHUNK_SIZE, displayPtr->getPlaneSize() - offset);
+      file.read(chunk.data(), length);
+      diff->addChunk(plane + offset, chunk.data(), offset, length);
+    }
+  }
+  file.close();
+
+  long differentPixelCount = blackDiff.getDifferentPixelCount() + redDiff.getDifferentPixelCount();
+  if (differentPixelCount > 0) {
+    LOG_WARNING("Frame %d differs from golden frame: %lu black and %lu red pixels.", frameIndex,
+                static_cast<unsigned long>(blackDiff.getDifferentPixelCount()), static_cast<unsigned long>(redDiff.getDifferentPixelCount()));
+    for (FrameDiff* diff : {&blackDiff, &redDiff}) {
+      if (diff->getDifferentPixelCount() > 0) {
+        int x0, y0, x1, y1;
+        diff->getBoundingBox(x0, y0, x1, y1);
+        LOG_WARNING("Frame %d differs in %s in [%d, %d] x [%d, %d] (physical).", frameIndex, (diff == &blackDiff) ? "black" : "red", x0, x1, y0, y1);
+      }
+    }
+  }
+  return differentPixelCount;
+}
+
+
+/// Reads the golden CRCs of the frames from the LittleFS, one hexadecimal
+/// CRC per line in frame order. Lines starting with '#' are skipped.
+std::vector<uint32_t> loadGoldenCrcs() {
+  std::vector<uint32_t> crcs;
+  File file = LittleFS.open("/replay/golden_crcs.txt", "r");
+  if (!file) {
+    return crcs;
+  }
+  while (file.available()) {
+    String line = file.readStringUntil('\n');
+    line.trim();
+    if (line.length() > 0 && !line.startsWith("#")) {
+      crcs.push_back(strtoul(line.c_str(), nullptr, 16));
+    }
+  }
+  file.close();
+  return crcs;
+}
+
+
+/// The main function for the replay mode, replacing longRunningFunctionsMain.
+/// It loads the recorded feeds and redraws the display in steps of the
+/// redraw interval of virtual time, starting as soon as the range of the
+/// current zoom level is covered by the recording.
+void replayMain(void*) {
+  if (!LittleFS.begin()) {
+    LOG_ERROR("Could not mount LittleFS!");
+    vTaskDelete(NULL);
+  }
+  for (const PVChannel& channel : channels) {
+    File file = LittleFS.open("/replay/" + channel.id + ".json", "r");
+    if (!file || !feedReplay.loadChannel(channel.id, file)) {
+      LOG_ERROR("Could not load recorded feed of channel %s", channel.id.c_str());
+      vTaskDelete(NULL);
+    }
+    file.close();
+  }
+
+  for (const PVChannel& channel : channels) {
+    PacForecastBacktest backtest(PacForecaster(), config.redrawIntervalSeconds);
+    feedReplay.forEachValue(channel.id, 3, [&backtest](time_t timestamp, float pAC) {
+      backtest.addSample(static_cast<double>(timestamp), pAC);
+    });
+    LOG_INFO("P_AC forecast backtest of channel %s: %ld samples, MAE %.1f W (holding %.1f W), RMSE %.1f W (holding %.1f W).",
+             channel.id.c_str(), backtest.getComparedCount(), backtest.getForecastMae(), backtest.getHoldMae(),
+             backtest.getForecastRmse(), backtest.getHoldRmse());
+  }
+
+  time_t firstTimestamp = feedReplay.getFirstTimestamp();
+  time_t lastTimestamp = feedReplay.getLastTimestamp();
+  time_t start = std::min<time_t>(firstTimestamp + ZOOM_TO_RANGE_MINUTES[zoom] * 60L, lastTimestamp);
+  unsigned long startMillis = millis();
+  int frameCount = 0;
+  unsigned long maxFrameMicros = 0;
+  uint64_t sumFrameMicros = 0;
+  uint64_t sumRenderMicros = 0;
+  uint64_t sumPanelBusyMillis = 0;
+  int comparedFrameCount = 0;
+  int differentFrameCount = 0;
+  std::vector<uint32_t> goldenCrcs = loadGoldenCrcs();
+  int differentCrcCount = 0;
+
+  for (time_t virtualNow = start; virtualNow <= lastTimestamp; virtualNow += config.redrawIntervalSeconds) {
+    // Keep the pace of the virtual clock unless the frames take longer.
+    unsigned long dueMillis = startMillis + static_cast<uint64_t>(virtualNow - start) * 1000 / REPLAY_SPEEDUP;
+    while (static_cast<long>(millis() - dueMillis) < 0) {
+      delay(1);
+    }
+
+    feedReplay.setNow(virtualNow);
+    unsigned long frameStartMicros = micros();
+    queryDataAndRedraw(zoom);
+    unsigned long frameMicros = micros() - frameStartMicros;
+    if (frameCount < REPLAY_DUMPED_FRAME_COUNT) {
+      dumpFrame(frameCount);
+    }
+    long differentPixelCount = compareWithGoldenFrame(frameCount);
+    if (differentPixelCount >= 0) {
+      ++comparedFrameCount;
+      differentFrameCount += (differentPixelCount > 0) ? 1 : 0;
+    }
+    uint32_t crc = crc32_le(0, displayPtr->getBlackPlane(), displayPtr->getPlaneSize());
+    crc = crc32_le(crc, displayPtr->getRedPlane(), displayPtr->getPlaneSize());
+    if (frameCount < static_cast<int>(goldenCrcs.size()) && crc != goldenCrcs[frameCount]) {
+      LOG_WARNING("Frame %d has CRC %08x instead of golden CRC %08x.", frameCount, static_cast<unsigned>(crc),
+                  static_cast<unsigned>(goldenCrcs[frameCount]));
+      ++differentCrcCount;
+    }
+    maxFrameMicros = std::max(maxFrameMicros, frameMicros);
+    sumFrameMicros += frameMicros;
+    sumRenderMicros += lastFrameTiming.renderMicros;
+    sumPanelBusyMillis += lastFrameTiming.panelBusyMillis;
+
+    LOG_INFO("Replay frame %d at %ld: CRC %08x, total %lu ms, rendering %lu ms, transfer %lu ms, free heap %lu bytes.",
+             frameCount, static_cast<long>(virtualNow), static_cast<unsigned>(crc), frameMicros / 1000, lastFrameTiming.renderMicros / 1000,
+             lastFrameTiming.transferMicros / 1000, static_cast<unsigned long>(ESP.getFreeHeap()));
+    ++frameCount;
+  }
+
+  if (frameCount > 0) {
+    LOG_INFO("Replay completed: %d frames, mean %lu ms (rendering %lu ms), max %lu ms.", frameCount,
+             static_cast<unsigned long>(sumFrameMicros / frameCount / 1000),
+             static_cast<unsigned long>(sumRenderMicros / frameCount / 1000), maxFrameMicros / 1000);
+    if (HAS_SIMULATED_PANEL) {
+      LOG_INFO("Simulated panel was busy for %lu s in total.", static_cast<unsigned long>(sumPanelBusyMillis / 1000));
+    }
+  }
+  if (comparedFrameCount > 0) {
+    LOG_INFO("Golden frames: %d of %d compared frames differ.", differentFrameCount, comparedFrameCount);
+  }
+  if (!goldenCrcs.empty()) {
+    LOG_INFO("Golden CRCs: %d of %d compared frames differ.", differentCrcCount, std::min<int>(frameCount, goldenCrcs.size()));
+  }
+  vTaskDelete(NULL);
+}
+#endif
+
+
+/// Wakes up the ammeter output task.
+void IRAM_ATTR onAmmeterTimer() {
+  BaseType_t isHigherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(ammeterOutputTask, &isHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(isHigherPriorityTaskWoken);
+}
+
+
+/// The main function of the ammeter output task, which owns the ammeter
+/// and advances it towards the newest target value on each timer tick.
+void ammeterOutputMain(void*) {
+  bool wasTestSignalActive = false;
+  uint32_t shapedStepResponseMillis = 0;
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint32_t stepResponseMillis = ammeterStepResponseMillis.load(std::memory_order_relaxed);
+    if (HAS_AMMETER_SHAPING && stepResponseMillis != shapedStepResponseMillis) {
+      ammeterShaper.configure(stepResponseMillis >> 16, stepResponseMillis & 0xFFFF, AMMETER_UPDATE_INTERVAL_MS);
+      shapedStepResponseMillis = stepResponseMillis;
+    }
+    int value;
+    if (isTestSignalActive.load(std::memory_order_relaxed)) {
+      if (!wasTestSignalActive) {
+        testSignal.configure(TEST_SIGNAL_SHAPE, TEST_SIGNAL_FREQUENCY_HZ);
+      }
+      wasTestSignalActive = true;
+      value = testSignal.getNextSample();
+    } else {
+      wasTestSignalActive = false;
+      value = ammeterTargetValue.load(std::memory_order_relaxed);
+    }
+    float position = value / 255.0f;
+    ammeterGauge.setTarget(HAS_AMMETER_SHAPING ? ammeterShaper.shape(position) : position);
+    ammeterGauge.update(micros());
+  }
+}
+
+
+/// Advances the characterization of the step response of the ammeter by the
+/// given push button states and returns the value to be shown. On
+/// completion, the measured times are used by the ammeter output task right
+/// away and saved in a copy of the configuration. On a timeout, the given
+/// previous times are used again.
+int updateAmmeterCharacterization(bool isButtonBPressed, bool isButtonCPressed, uint32_t previousStepResponseMillis) {
+  unsigned long now = millis();
+  if (isButtonBPressed) {
+    ammeterCharacterization.markPeak(now);
+  }
+  if (isButtonCPressed) {
+    ammeterCharacterization.markSettled(now);
+  }
+  float level = ammeterCharacterization.update(now);
+  if (ammeterCharacterization.isCompleted()) {
+    uint16_t peakMillis = ammeterCharacterization.getPeakMillis();
+    uint16_t settlingMillis = ammeterCharacterization.getSettlingMillis();
+    LOG_INFO("Ammeter step response: peak after %u ms, settled after %u ms, damping ratio %.2f.",
+             peakMillis, settlingMillis, ZeroVibrationShaper::getDampingRatio(peakMillis, settlingMillis));
+    xSemaphoreTake(configMutex, portMAX_DELAY);
+    ammeterStepResponseMillis.store(packStepResponseMillis(peakMillis, settlingMillis));
+    BoxleConfig savedConfig = getCurrentConfig();
+    if (!configStore.save(savedConfig)) {
+      LOG_ERROR("Could not save configuration.");
+    }
+    xSemaphoreGive(configMutex);
+    ammeterCharacterization = StepResponseCharacterization();
+  } else if (!ammeterCharacterization.isActive()) {
+    // Timed out. Shape with the previous times again.
+    ammeterStepResponseMillis.store(previousStepResponseMillis);
+  }
+  return static_cast<int>(255.0f * level);
+}
+
+
 /// The main function (static schedule) for all short-running functions
-/// such as determining the state of the push buttons and updating the
-/// analogy display.
+/// such as determining the state of the push buttons and computing the
+/// target value of the analog display.
 void shortRunningFunctionsMain() {
-  unsigned long nextRegularAmmeterUpdateMillis = millis();
-  int lastAnalogDisplayValue = -1;
+  bool isButtonAHeld = false;
+  unsigned long buttonAPressMillis = 0;
+  bool isButtonBHeld = false;
+  bool isButtonCHeld = false;
+  bool isButtonDHeld = false;
+  unsigned long buttonDPressMillis = 0;
+  uint32_t previousStepResponseMillis = 0;
   while(true) {
     int analogDisplayValue = 0;
 
+    bool isButtonBPressed = (digitalRead(PUSH_BUTTON_B_PIN) == LOW);
+    bool isButtonCPressed = (digitalRead(PUSH_BUTTON_C_PIN) == LOW);
+    bool isButtonDPressed = (digitalRead(PUSH_BUTTON_D_PIN) == LOW);
+    if (ammeterCharacterization.isActive()) {
+      analogDisplayValue = updateAmmeterCharacterization(isButtonBPressed && !isButtonBHeld, isButtonCPressed && !isButtonCHeld,
+                                                         previousStepResponseMillis);
+      isButtonBHeld = isButtonBPressed;
+      isButtonCHeld = isButtonCPressed;
+      isButtonDHeld = isButtonDPressed;
+      buttonDPressMillis = millis();  // No restart by a button D still held.
+      ammeterTargetValue.store(analogDisplayValue, std::memory_order_relaxed);
+      delay(20);
+      continue;
+    }
+    isButtonBHeld = isButtonBPressed;
+    isButtonCHeld = isButtonCPressed;
+    if (isButtonDPressed && !isButtonDHeld) {
+      buttonDPressMillis = millis();
+    } else if (HAS_AMMETER_SHAPING && isButtonDPressed && millis() - buttonDPressMillis >= LONG_PRESS_MS) {
+      LOG_INFO("Ammeter step response: mark the first peak by B and the settled needle by C.");
+      previousStepResponseMillis = ammeterStepResponseMillis.exchange(0);  // Unshaped steps.
+      ammeterCharacterization.start(millis());
+      isButtonDHeld = true;
+      continue;
+    }
+    isButtonDHeld = isButtonDPressed;
+
+    bool isButtonAPressed = (digitalRead(PUSH_BUTTON_A_PIN) == LOW);
+    if (isButtonAPressed && !isButtonAHeld) {
+      buttonAPressMillis = millis();
+    } else if (!isButtonAPressed && isButtonAHeld && millis() - buttonAPressMillis < LONG_PRESS_MS) {
+      int mode = (gaugeModeIndex.load() + 1) % GAUGE_MODE_COUNT;
+      gaugeModeIndex.store(mode);
+      LOG_INFO("Gauge mode: %s", gaugeModes[mode].label);
+    }
+    isButtonAHeld = isButtonAPressed;
+
     if (digitalRead(PUSH_BUTTON_A_PIN) == LOW) {
-      Serial.println("Push button A (very left) is pressed.");
+      LOG_DEBUG_EVERY(BUTTON_LOG_INTERVAL_MS, "Push button A (very left) is pressed.");
     }
     if (digitalRead(PUSH_BUTTON_B_PIN) == LOW) {
-      Serial.println("Push button B (middle left) is pressed.");
+      LOG_DEBUG_EVERY(BUTTON_LOG_INTERVAL_MS, "Push button B (middle left) is pressed.");
     }
     if (digitalRead(PUSH_BUTTON_C_PIN) == LOW) {
-      Serial.println("Push button C (middle right) is pressed.");
+      LOG_DEBUG_EVERY(BUTTON_LOG_INTERVAL_MS, "Push button C (middle right) is pressed.");
     }
     if (digitalRead(PUSH_BUTTON_D_PIN) == LOW) {
-      Serial.println("Push button D (very right) is pressed.");
+      LOG_DEBUG_EVERY(BUTTON_LOG_INTERVAL_MS, "Push button D (very right) is pressed.");
     }
 
-    if (digitalRead(PUSH_BUTTON_A_PIN) == LOW) {
-      // Sinus wave with 0.25 Hz.
-      analogDisplayValue = 128 + static_cast<int>(127.0f * sin(0.25 * 2.0f * PI * millis() / 1000.0f));
-    } else if (digitalRead(PUSH_BUTTON_B_PIN) == LOW) {
-      // Show zero power value.
-      float pAC = 0.0f;
-      analogDisplayValue = static_cast<int>(255.0f * pAC / 1000.0f);
-    } else if (digitalRead(PUSH_BUTTON_C_PIN) == LOW) {
-      // Show power value of 300 W.
-      float pAC = 300.0f;
-      analogDisplayValue = static_cast<int>(255.0f * pAC / 1000.0f);
-    } else if (digitalRead(PUSH_BUTTON_D_PIN) == LOW) {
-      // Show power value of 600 W.
-      float pAC = 600.0f;
-      analogDisplayValue = static_cast<int>(255.0f * pAC / 1000.0f);
-    } else {
-      xSemaphoreTake(globalMutex, 10 * portTICK_PERIOD_MS);
-      if (newestData.totalYield > 0 && newestData.age < 900) {
-        analogDisplayValue = static_cast<int>(255.0f * newestData.pAC / 1000.0f);
+    bool isTestSignalRequested = isButtonAHeld && millis() - buttonAPressMillis >= LONG_PRESS_MS;
+    isTestSignalActive.store(isTestSignalRequested, std::memory_order_relaxed);
+    // Otherwise, the test signal is generated by the ammeter output task.
+    if (!isTestSignalRequested) {
+      if (digitalRead(PUSH_BUTTON_B_PIN) == LOW) {
+        // Show zero power value.
+        float pAC = 0.0f;
+        analogDisplayValue = static_cast<int>(255.0f * pAC / config.ammeterFullScaleWatts);
+      } else if (digitalRead(PUSH_BUTTON_C_PIN) == LOW) {
+        // Show power value of 30 % of full scale.
+        float pAC = 0.3f * config.ammeterFullScaleWatts;
+        analogDisplayValue = static_cast<int>(255.0f * pAC / config.ammeterFullScaleWatts);
+      } else if (digitalRead(PUSH_BUTTON_D_PIN) == LOW) {
+        // Show power value of 60 % of full scale.
+        float pAC = 0.6f * config.ammeterFullScaleWatts;
+        analogDisplayValue = static_cast<int>(255.0f * pAC / config.ammeterFullScaleWatts);
+      } else {
+        const GaugeMode& mode = gaugeModes[gaugeModeIndex.load()];
+        xSemaphoreTake(globalMutex, 10 * portTICK_PERIOD_MS);
+        PVSingleData data = newestData;
+        float value = data.getValue(mode.field);
+        if (HAS_PAC_FORECAST && mode.field == PV_FIELD_PAC && pacForecaster.hasForecast()) {
+          value = pacForecaster.getForecast(static_cast<double>(getCurrentTimestamp()));
+        }
+        xSemaphoreGive(globalMutex);
+        if (data.quality.isFresh(mode.field)) {
+          analogDisplayValue = static_cast<int>(255.0f * mode.getPosition(value));
+        }
       }
-      xSemaphoreGive(globalMutex);
     }
     analogDisplayValue = std::min(analogDisplayValue, 255);
     analogDisplayValue = std::max(analogDisplayValue, 0);
+    ammeterTargetValue.store(analogDisplayValue, std::memory_order_relaxed);
+    delay(100);
+  }
+}
 
-    if (analogDisplayValue != lastAnalogDisplayValue || millis() >= nextRegularAmmeterUpdateMillis) {
-#ifdef STEPPER_AS_AMMETER
-      ammeterServo.attach(AMMETER_PIN);
-      int angle = static_cast<int>(90.0f * analogDisplayValue / 255.0f);
-      ammeterServo.write(angle);
-      delay(200);
-      ammeterServo.detach();
-#else
-      analogWrite(AMMETER_PIN, analogDisplayValue);
-#endif
-      // Avoid continuous update of ammeter, which may cause strange sounds
-      // if ammeter is implemented by stepper motor.
-      nextRegularAmmeterUpdateMillis = millis() + 5000;
-      lastAnalogDisplayValue = analogDisplayValue;
+
+/// The main function of the log output task, which writes the buffered log
+/// messages to Serial.
+void logOutputMain(void*) {
+  char message[LogBuffer::MESSAGE_SIZE];
+  while (true) {
+    uint32_t droppedCount = getLogBuffer().takeDroppedCount();
+    if (droppedCount > 0) {
+      Serial.printf("(%lu log messages dropped)\n", static_cast<unsigned long>(droppedCount));
     }
-    delay(100);
+    while (getLogBuffer().pop(message)) {
+      Serial.println(message);
+    }
+    delay(LOG_OUTPUT_INTERVAL_MS);
   }
 }
 
@@ -333,52 +1235,146 @@ void shortRunningFunctionsMain() {
 /// The start-up function called by the ESP32 platform.
 void setup() {
   Serial.begin(115200);
+  xTaskCreatePinnedToCore(logOutputMain, "logOutputTask", 3072, NULL, 0, &logOutputTask, 0);
 
-  displayPtr = new GxEPD2_3C<GxEPD2_583c_Z83, GxEPD2_583c_Z83::HEIGHT>(GxEPD2_583c_Z83(E_PAPER_CS, E_PAPER_DC, E_PAPER_RST, E_PAPER_BUSY));
+  displayPtr = new TriColorDisplay<BoxlePanel>(BoxlePanel(E_PAPER_CS, E_PAPER_DC, E_PAPER_RST, E_PAPER_BUSY));
 
-  pinMode(AMMETER_PIN, OUTPUT);
+  ammeterGauge.begin();
 
   pinMode(PUSH_BUTTON_A_PIN, INPUT_PULLUP);
   pinMode(PUSH_BUTTON_B_PIN, INPUT_PULLUP);
   pinMode(PUSH_BUTTON_C_PIN, INPUT_PULLUP);
   pinMode(PUSH_BUTTON_D_PIN, INPUT_PULLUP);
 
-  Serial.print("Initializing display ...");
+  LOG_INFO("Initializing display ...");
   displayPtr->init();
+  displayPtr->epd2.setBusyCallback(waitWhilePanelBusy);
+  displayPtr->enableBandPipeline(PIPELINED_BAND_COUNT, 1);
+#if HAS_DMA_FRAME_TRANSFER && !HAS_SIMULATED_PANEL
+  displayPtr->setBandWriter([](const uint8_t* black, const uint8_t* red, int16_t firstRow, int16_t rowCount) {
+    // GxEPD2 initializes the controller on the first write only. Hence,
+    // let GxEPD2 write the first row of each frame, which also covers the
+    // power-on. Then, the SPI bus is taken over for all bands of the frame
+    // and handed back after the last one for the refresh by GxEPD2. Only
+    // the DMA transfer itself is timed.
+    if (firstRow == 0) {
+      displayPtr->epd2.writeImage(black, red, 0, 0, GxEPD2_583c_Z83::WIDTH, 1);
+      if (!dmaPanelWriter.beginFrame()) {
+        LOG_WARNING("SPI bus not available for DMA, falling back to GxEPD2.");
+      }
+    }
+    unsigned long writeStartMicros = micros();
+    bool isWritten = dmaPanelWriter.write(black, red, GxEPD2_583c_Z83::WIDTH / 8, firstRow, rowCount);
+    dmaWriteMicros += micros() - writeStartMicros;
+    if (!isWritten) {
+      displayPtr->epd2.writeImage(black, red, 0, firstRow, GxEPD2_583c_Z83::WIDTH, rowCount);
+    }
+    if (firstRow + rowCount == GxEPD2_583c_Z83::HEIGHT) {
+      dmaPanelWriter.endFrame();
+    }
+  });
+#endif
+  attachInterrupt(digitalPinToInterrupt(E_PAPER_BUSY), onPanelBusyChanged, CHANGE);
   u8g2Fonts.begin(*displayPtr);
-  Serial.println(" done.");
+  LOG_INFO("Initializing display done.");
+
+  preferences.begin("boxle", false);
+  if (digitalRead(PUSH_BUTTON_A_PIN) == LOW) {
+    configStore.clear();
+    LOG_WARNING("Push button A held at boot, configuration reset to the defaults.");
+  }
+  loadedConfig = getDefaultConfig();
+  if (configStore.load(loadedConfig)) {
+    LOG_INFO("Loaded configuration from NVS.");
+  }
+
+  DailyYieldHistory::State yieldHistoryState;
+  if (!HAS_REPLAY_MODE && preferences.getBytes("yieldHistory", &yieldHistoryState, sizeof(yieldHistoryState)) == sizeof(yieldHistoryState)) {
+    dailyYieldHistory.restoreState(yieldHistoryState);
+  }
+
+  AnomalyEventLog::State anomalyLogState;
+  if (!HAS_REPLAY_MODE && preferences.getBytes("anomalyLog", &anomalyLogState, sizeof(anomalyLogState)) == sizeof(anomalyLogState)) {
+    anomalyLog.restoreState(anomalyLogState);
+  }
+  if (!HAS_REPLAY_MODE) {
+    // The progress is only persisted at the regular restart, thus continue
+    // at least after the newest logged event.
+    lastAnomalyCheckTimestamp = std::max<time_t>(anomalyLog.getNewestTimestamp(), preferences.getUInt("anomalyCheck", 0));
+  }
+
+  String channelList = config.thingSpeakChannels;
+  int start = 0;
+  while (start <= static_cast<int>(channelList.length())) {
+    int end = channelList.indexOf(',', start);
+    if (end < 0) {
+      end = channelList.length();
+    }
+    PVChannel channel;
+    channel.id = channelList.substring(start, end);
+    channel.id.trim();
+    if (channel.id.length() > 0) {
+      channels.push_back(channel);
+    }
+    start = end + 1;
+  }
+  if (channels.empty()) {
+    LOG_ERROR("No ThingSpeak channel configured!");
+    channels.emplace_back();
+  }
+  if (HAS_CONFIGURED_PV_PEAK_WATTS && PV_PEAK_WATTS_PER_CHANNEL.size() > 1 && PV_PEAK_WATTS_PER_CHANNEL.size() != channels.size()) {
+    LOG_WARNING("PV_PEAK_WATTS lists %u channels, but %u are configured. The clear-sky model uses the sum of the list.",
+                static_cast<unsigned>(PV_PEAK_WATTS_PER_CHANNEL.size()), static_cast<unsigned>(channels.size()));
+  }
+
+  gaugeModes = {
+    GaugeMode("Leistung", PV_FIELD_PAC, 0.0f, config.ammeterFullScaleWatts),
+    GaugeMode("Frequenz", PV_FIELD_FREQUENCY, 49.8f, 50.2f),
+    GaugeMode("Spannung", PV_FIELD_UAC, 220.0f, 240.0f),
+    GaugeMode("Tagesertrag", PV_FIELD_TODAY_YIELD, 0.0f, DAILY_YIELD_TARGET_KWH)
+  };
+
+  ammeterStepResponseMillis.store(packStepResponseMillis(config.ammeterPeakMillis, config.ammeterSettlingMillis));
+
+  if (HAS_CONFIGURED_PV_PEAK_WATTS) {
+    pacForecaster.setUpperBound([](double timestamp) {
+      return CLEAR_SKY_FORECAST_MARGIN * clearSkyModel.getExpectedWatts(static_cast<time_t>(timestamp));
+    });
+  }
 
   globalMutex = xSemaphoreCreateMutex();
+  configMutex = xSemaphoreCreateMutex();
 }
 
 
 /// The main function called by the ESP32 platform. It is splitted into two
-/// threads for long-running and short-running functions.
+/// threads for long-running and short-running functions, plus the ammeter
+/// output task.
 void loop() {
+  xTaskCreatePinnedToCore(ammeterOutputMain, "ammeterOutputTask", 4096, NULL, 3, &ammeterOutputTask, 1);
+  ammeterTimer = timerBegin(0, 80, true);  // 1 MHz
+  timerAttachInterrupt(ammeterTimer, onAmmeterTimer, true);
+  timerAlarmWrite(ammeterTimer, AMMETER_UPDATE_INTERVAL_MS * 1000, true);
+  timerAlarmEnable(ammeterTimer);
+
+#if HAS_REPLAY_MODE
+  xTaskCreatePinnedToCore(replayMain, "longRunningFunctionsTask", 25000, NULL, 0, &longRunningFunctionsTask, 0);
+#else
   xTaskCreatePinnedToCore(longRunningFunctionsMain, "longRunningFunctionsTask", 25000, NULL, 0, &longRunningFunctionsTask, 0);
+#endif
   shortRunningFunctionsMain();
 }
 
 
-/// Converts the given relative time (negative number of seconds) into a
-/// string representation in hours or even days for the x-axes of the plots. 
-String relativeHoursOrDayLabelFromSeconds(int seconds) {
-  assert(seconds <= 0);
-
-  if (seconds == 0) {
-    return String("now");
-  } else if (seconds == -3 * 3600) {
-    return String("-3h");
-  } else if (seconds == -6 * 3600) {
-    return String("-6h");
-  } else if (seconds == -12 * 3600) {
-    return String("-12h");
-  } else if (seconds <= -24 * 3600) {
-    return "-" + String(seconds / (-24 * 3600)) + "d";
-  }
-
-  assert(false);  
-  return String("?");
+/// Updates only the indicator of the gauge mode on the e-Ink display by a
+/// refresh of its area.
+void updateGaugeModeIndicator() {
+  shownGaugeModeIndex = gaugeModeIndex.load();
+  displayPtr->setRotation(2);
+  displayPtr->setTextColor(GxEPD_BLACK);
+  FrameRenderer::drawGaugeModeIndicator(*displayPtr, gaugeModes[shownGaugeModeIndex].label);
+  displayPtr->updateWindow(0, 0, GAUGE_INDICATOR_WIDTH, GAUGE_INDICATOR_HEIGHT);
+  displayPtr->powerOff();
 }
 
 
@@ -386,222 +1382,110 @@ String relativeHoursOrDayLabelFromSeconds(int seconds) {
 /// e-Ink display accordingly.
 void queryDataAndRedraw(int zoom) {
   struct tm currentTime;
-  if (!getLocalTime(&currentTime, 10000)) {
-    Serial.println(F("Could not get current time!"));
+  if (!getCurrentTime(currentTime)) {
+    LOG_WARNING("Could not get current time!");
     return;
   }
 
   // secondsDiffModuloOneMinute = currentTime.tm_sec - (millis() / 1000);
-  queryNewestData(currentTime);
-  std::vector<PlotPoint> pacCurve = queryPACCurve(currentTime, zoom);
-  std::vector<PlotPoint> uacCurve = queryUACCurve(currentTime, zoom);
-  std::vector<PlotPoint> frequencyCurve = queryFrequencyCurve(currentTime, zoom);
-    
-  displayPtr->setFullWindow();
-  displayPtr->setRotation(2);
-  displayPtr->setTextColor(GxEPD_BLACK);
-  u8g2Fonts.setForegroundColor(GxEPD_BLACK);
-  u8g2Fonts.setBackgroundColor(GxEPD_WHITE);
-  displayPtr->firstPage();
-
-  PlotUtility pacPlot(40, 235, 360 - 15 - 40, 208, - ZOOM_TO_RANGE_MINUTES[zoom] * 60, 0, 0, 650);
-  pacPlot.setXTicks({{- ZOOM_TO_RANGE_MINUTES[zoom] * 60, relativeHoursOrDayLabelFromSeconds(- ZOOM_TO_RANGE_MINUTES[zoom] * 60)},
-                  {- ZOOM_TO_RANGE_MINUTES[zoom] * 30, relativeHoursOrDayLabelFromSeconds(- ZOOM_TO_RANGE_MINUTES[zoom] * 30)},
-                  {0, relativeHoursOrDayLabelFromSeconds(0)}});
-  pacPlot.setYTicks({{0, "0"}, {200, "200"}, {400, "400"}, {600, "600"}});
-  
-  PlotUtility uacPlot(360 + 35, 235, 635 - (360 + 35), 86, - ZOOM_TO_RANGE_MINUTES[zoom] * 60, 0, 220, 240);
-  uacPlot.setXTicks({{- ZOOM_TO_RANGE_MINUTES[zoom] * 60, relativeHoursOrDayLabelFromSeconds(- ZOOM_TO_RANGE_MINUTES[zoom] * 60)},
-                  {- ZOOM_TO_RANGE_MINUTES[zoom] * 30, relativeHoursOrDayLabelFromSeconds(- ZOOM_TO_RANGE_MINUTES[zoom] * 30)},
-                  {0, relativeHoursOrDayLabelFromSeconds(0)}});
-  uacPlot.setYTicks({{220, "220"}, {230, "230"}, {240, "240"}});
-  
-  PlotUtility frequencyPlot(360 + 35, 235 + 208 - 86, 635 - (360 + 35), 86, - ZOOM_TO_RANGE_MINUTES[zoom] * 60, 0, 49.9, 50.1);
-  frequencyPlot.setXTicks({{- ZOOM_TO_RANGE_MINUTES[zoom] * 60, relativeHoursOrDayLabelFromSeconds(- ZOOM_TO_RANGE_MINUTES[zoom] * 60)},
-                  {- ZOOM_TO_RANGE_MINUTES[zoom] * 30, relativeHoursOrDayLabelFromSeconds(- ZOOM_TO_RANGE_MINUTES[zoom] * 30)},
-                  {0, relativeHoursOrDayLabelFromSeconds(0)}});
-  frequencyPlot.setYTicks({{49.9, "49.9"}, {50.0, "50.0"}, {50.1, "50.1"}});
-  
-  Serial.println(F("Starting redrawing of e-paper display."));
-  do {
-    displayPtr->fillScreen(GxEPD_WHITE);
-
-    // Current P_AC.
-    if (newestData.totalYield > 0 && newestData.age < 900) {
-      u8g2Fonts.setFont(u8g2_font_logisoso92_tn);
-      String currentPAC = String(newestData.pAC, 0);
-      int16_t textWidth = u8g2Fonts.getUTF8Width(currentPAC.c_str());
-      u8g2Fonts.setCursor(200 - 20 - textWidth, 156);
-      u8g2Fonts.print(currentPAC);
-      displayPtr->setFont(&FreeSansBold24pt7b);
-      displayPtr->setCursor(200, 156);
-      displayPtr->print("Watt");
-    } else {
-      displayPtr->setFont(&FreeSansBold24pt7b);
-      displayPtr->setCursor(0, 156);
-      displayPtr->print("Kein Ertrag!");
-    }
-
-    // Current time.
-    displayPtr->setFont(&FreeSans12pt7b);
-    char stringBuffer[50];
-    strftime(stringBuffer, sizeof(stringBuffer), "%H:%M", &currentTime);
-    String timeString = stringBuffer + String(" (UTC)");
-    displayPtr->setCursor(635 - display_getTextWidth(timeString), 21);
-    displayPtr->print(timeString);
-
-    // Other current values
-    displayPtr->setFont(&FreeSans12pt7b);
-    String currentUAC = "Netzspannung: -";
-    String currentFrequency = "Frequenz: -";
-    String currentTemperature = "Temperatur: -";
-    String currentEfficiency = "Effizienz: -";
-    String totalYield = "Gesamtertrag: -";
-    if (newestData.totalYield > 0) {
-      if (newestData.age < 900) {
-        currentUAC = "Netzspannung: " + String(newestData.uAC, 1) + " V";
-        currentFrequency = "Frequenz: " + String(newestData.frequency, 2) + " Hz";
-        currentTemperature = "Temperatur: " + String(newestData.temperature, 1) + " C";
-        currentEfficiency = "Effizienz: " + String(newestData.efficiency, 1) + " %";
-      }
-      totalYield = "Gesamtertrag: " + String(newestData.totalYield, 1) + " kWh";
-    }
-    displayPtr->setCursor(360, 60);
-    displayPtr->print(currentUAC);
-    displayPtr->setCursor(360, 92);
-    displayPtr->print(currentFrequency);
-    displayPtr->setCursor(360, 124);
-    displayPtr->print(currentTemperature);
-    displayPtr->setCursor(360, 156);
-    displayPtr->print(currentEfficiency);
-    displayPtr->setCursor(360, 188);
-    displayPtr->print(totalYield);
-
-    {
-      int y = pacPlot.getYPixelForYValue(600.0);
-      displayPtr->drawLine(40, y, 360 - 15, y, GxEPD_RED);
-    }
-
-    pacPlot.drawXAxis([displayPtr](int x0, int y0, int x1, int y1) {
-      displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-    });
-
-    pacPlot.drawYAxis([displayPtr](int x0, int y0, int x1, int y1) {
-      displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-    });
-
-    pacPlot.drawXTicks([displayPtr](int x, int y, double relativePosition, String label) {
-      displayPtr->drawLine(x, y, x, y + 2, GxEPD_BLACK);
-      displayPtr->setFont(&FreeSans9pt7b);
-      displayPtr->setCursor(x - static_cast<int>(relativePosition * display_getTextWidth(label)), y + 18);
-      displayPtr->print(label.c_str());
-    });
-
-    pacPlot.drawYTicks([displayPtr](int x, int y, double relativePosition, String label) {
-      displayPtr->drawLine(x - 2, y, x, y, GxEPD_BLACK);
-      displayPtr->setFont(&FreeSans9pt7b);
-      displayPtr->setCursor(40 - 4 - display_getTextWidth(label), y + 5);
-      displayPtr->print(label.c_str());
-    });
-
-    pacPlot.drawPoints(pacCurve, [displayPtr](int x, int y, PlotPoint point) {
-      displayPtr->fillRect(x - 1, y - 1, 3, 3, GxEPD_BLACK);
-    });
-
-    pacPlot.drawLinesBetweenPoints(pacCurve, [displayPtr](int x0, int y0, int x1, int y1, PlotPoint point0, PlotPoint point1) {
-      displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-    });
-
-    {
-      int y = uacPlot.getYPixelForYValue(230.0);
-      displayPtr->drawLine(360 + 35, y, 635, y, GxEPD_RED);
+  time_t now = mktime(&currentTime);
+  for (PVChannel& channel : channels) {
+    queryNewestData(channel, currentTime);
+  }
+  PVSingleData combinedData = combineNewestData();
+  if (combinedData.quality.isValid(PV_FIELD_TOTAL_YIELD)) {
+    int32_t today = static_cast<int32_t>(now / (24 * 3600));
+    if (dailyYieldHistory.update(today, combinedData.totalYield) && !HAS_REPLAY_MODE) {
+      preferences.putBytes("yieldHistory", &dailyYieldHistory.getState(), sizeof(DailyYieldHistory::State));
     }
-
-    uacPlot.drawXAxis([displayPtr](int x0, int y0, int x1, int y1) {
-      displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-    });
-
-    uacPlot.drawYAxis([displayPtr](int x0, int y0, int x1, int y1) {
-      displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-    });
-
-    uacPlot.drawXTicks([displayPtr](int x, int y, double relativePosition, String label) {
-      displayPtr->drawLine(x, y, x, y + 2, GxEPD_BLACK);
-      displayPtr->setFont(&FreeSans9pt7b);
-      displayPtr->setCursor(x - static_cast<int>(relativePosition * display_getTextWidth(label)), y + 18);
-      displayPtr->print(label.c_str());
-    });
-
-    uacPlot.drawYTicks([displayPtr](int x, int y, double relativePosition, String label) {
-      displayPtr->drawLine(x - 2, y, x, y, GxEPD_BLACK);
-      displayPtr->setFont(&FreeSans9pt7b);
-      displayPtr->setCursor(360 + 35 - 4 - display_getTextWidth(label), y + 5);
-      displayPtr->print(label.c_str());
-    });
-
-    uacPlot.drawPoints(uacCurve, [displayPtr](int x, int y, PlotPoint point) {
-      if (point.y != 0.0) {
-        displayPtr->fillRect(x - 1, y - 1, 3, 3, GxEPD_BLACK);
-      }
-    });
-
-    uacPlot.drawLinesBetweenPoints(uacCurve, [displayPtr](int x0, int y0, int x1, int y1, PlotPoint point0, PlotPoint point1) {
-      if (point0.y != 0.0 && point1.y != 0.0) {
-        displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-      }
-    });
-
-    {
-      int y = frequencyPlot.getYPixelForYValue(50.0);
-      displayPtr->drawLine(360 + 35, y, 635, y, GxEPD_RED);      
+  }
+  if (channels.front().newestData.timestamp > lastAnomalyCheckTimestamp) {
+    if (checkGridAnomalies(channels.front(), now) && !HAS_REPLAY_MODE) {
+      preferences.putBytes("anomalyLog", &anomalyLog.getState(), sizeof(AnomalyEventLog::State));
+      preferences.putUInt("anomalyCheck", static_cast<uint32_t>(lastAnomalyCheckTimestamp));
     }
+  }
+  std::vector<PlotPoint> dailyYields = dailyYieldHistory.getDailyYields();
+  if (!dailyYields.empty() && dailyYields.back().x == 0.0) {
+    combinedData.todayYield = dailyYields.back().y;
+    combinedData.quality.set(PV_FIELD_TODAY_YIELD, DataQualityFlags::assessValue(PV_FIELD_TODAY_YIELD, combinedData.todayYield,
+                                                                                 combinedData.age, config.maxDataAgeSeconds));
+  }
+  xSemaphoreTake(globalMutex, 10 * portTICK_PERIOD_MS);
+  newestData = combinedData;
+  if (clearSkyModel.updateDay(now)) {
+    LOG_INFO("Clear-sky model updated, expected peak at noon %.0f W.", clearSkyModel.getExpectedWatts(now - now % (24 * 3600) + 12 * 3600));
+  }
+  if (combinedData.quality.isFresh(PV_FIELD_PAC)) {
+    pacForecaster.addSample(static_cast<double>(combinedData.timestamp), combinedData.pAC);
+  }
+  xSemaphoreGive(globalMutex);
 
-    frequencyPlot.drawXAxis([displayPtr](int x0, int y0, int x1, int y1) {
-      displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-    });
-
-    frequencyPlot.drawYAxis([displayPtr](int x0, int y0, int x1, int y1) {
-      displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-    });
-
-    frequencyPlot.drawXTicks([displayPtr](int x, int y, double relativePosition, String label) {
-      displayPtr->drawLine(x, y, x, y + 2, GxEPD_BLACK);
-      displayPtr->setFont(&FreeSans9pt7b);
-      displayPtr->setCursor(x - static_cast<int>(relativePosition * display_getTextWidth(label)), y + 18);
-      displayPtr->print(label.c_str());
-    });
+  // The grid curves are the same for all inverters, thus taken from the
+  // first channel only.
+  for (size_t index = 0; index < channels.size(); ++index) {
+    updateChannelCurves(channels[index], zoom, index == 0);
+  }
 
-    frequencyPlot.drawYTicks([displayPtr](int x, int y, double relativePosition, String label) {
-      displayPtr->drawLine(x - 2, y, x, y, GxEPD_BLACK);
-      displayPtr->setFont(&FreeSans9pt7b);
-      displayPtr->setCursor(360 + 35 - 4 - display_getTextWidth(label), y + 5);
-      displayPtr->print(label.c_str());
-    });
+  FrameData frameData;
+  frameData.currentTime = currentTime;
+  frameData.now = now;
+  frameData.zoom = zoom;
+  frameData.newestData = combinedData;
+  for (const PVChannel& channel : channels) {
+    frameData.channelData.push_back(channel.newestData);
+    frameData.pacCurves.push_back(channel.pacCurve);
+    }
+  frameData.uacCurve = channels.front().uacCurve;
+  frameData.frequencyCurve = channels.front().frequencyCurve;
+  frameData.dailyYields = dailyYields;
+  frameData.anomalyLog = &anomalyLog;
+  frameData.clearSkyModel = &clearSkyModel;
+  frameData.pacPlotMaxWatts = (config.pacPlotMaxWatts > 0) ? config.pacPlotMaxWatts : NAN;
+  frameData.pacReferenceWatts = config.pacReferenceWatts;
+  shownGaugeModeIndex = gaugeModeIndex.load();
+  frameData.gaugeModeLabel = gaugeModes[shownGaugeModeIndex].label;
+  frameRenderer.prepare(frameData);
 
-    frequencyPlot.drawPoints(frequencyCurve, [displayPtr](int x, int y, PlotPoint point) {
-      if (point.y != 0.0) {
-        displayPtr->fillRect(x - 1, y - 1, 3, 3, GxEPD_BLACK);
-      }
-    });
+  displayPtr->setFullWindow();
+#if HAS_DMA_FRAME_TRANSFER && !HAS_SIMULATED_PANEL
+  dmaWriteMicros = 0;
+#endif
+  displayPtr->firstPage();
+  
+  LOG_INFO("Starting redrawing of e-paper display.");
+  unsigned long renderStartMicros = micros();
+  unsigned long renderMicros = 0;
+  do {
+    frameRenderer.render(*displayPtr, u8g2Fonts);
 
-    frequencyPlot.drawLinesBetweenPoints(frequencyCurve, [displayPtr](int x0, int y0, int x1, int y1, PlotPoint point0, PlotPoint point1) {
-      if (point0.y != 0.0 && point1.y != 0.0) {
-        displayPtr->drawLine(x0, y0, x1, y1, GxEPD_BLACK);
-      }
-    });
+    // With several bands, this is the time until the last band is rendered.
+    renderMicros = micros() - renderStartMicros;
   } while (displayPtr->nextPage());
-  Serial.println(F("Redrawing of e-paper display completed."));
+  lastFrameTiming.renderMicros = renderMicros;
+  lastFrameTiming.transferMicros = micros() - renderStartMicros - renderMicros;
+#if HAS_DMA_FRAME_TRANSFER && !HAS_SIMULATED_PANEL
+  unsigned long writeMicros = dmaWriteMicros.load();
+#else
+  unsigned long writeMicros = displayPtr->getLastTotalWriteMicros();
+#endif
+  LOG_INFO("Redrawing of e-paper display completed. Rendering took %lu ms, transfer and refresh took %lu ms. Writing the planes %s took %lu ms, "
+           "of which %lu ms were not hidden by rendering.", lastFrameTiming.renderMicros / 1000, lastFrameTiming.transferMicros / 1000,
+           (HAS_DMA_FRAME_TRANSFER && !HAS_SIMULATED_PANEL) ? "by DMA" : "by GxEPD2", writeMicros / 1000, displayPtr->getLastWriteMicros() / 1000);
   
-  Serial.print(F("Powering off the display ..."));
   displayPtr->powerOff();
-  Serial.println(F(" done."));
+  LOG_DEBUG("Powered off the display.");
+
+#if HAS_SIMULATED_PANEL
+  const BoxlePanel::CycleReport& report = displayPtr->epd2.getCycleReport();
+  lastFrameTiming.panelBusyMillis = report.getBusyMillis();
+  LOG_INFO("Simulated panel: %u writes with %lu bytes, %u full and %u partial refreshes, busy for %lu ms "
+           "(transfer %lu ms, refresh %lu ms, power %lu ms).",
+           static_cast<unsigned>(displayPtr->epd2.getWindowWrites().size()), static_cast<unsigned long>(report.writtenBytes),
+           report.fullRefreshCount, report.partialRefreshCount, static_cast<unsigned long>(report.getBusyMillis()),
+           static_cast<unsigned long>(report.transferMillis), static_cast<unsigned long>(report.refreshMillis),
+           static_cast<unsigned long>(report.powerMillis));
+  displayPtr->epd2.startCycle();
+#endif
 }
 
-
-/// Returns the width of the given text in pixels on the e-Ink display.
-uint16_t display_getTextWidth(String text) {
-  int16_t x, y;
-  uint16_t width, height;
-  displayPtr->getTextBounds(text, 0, 0, &x, &y, &width, &height);
-  return width;
-}
@@ -0,0 +1,171 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Host benchmark of the word-wide kernels of TriColorFrameBuffer against the
+// per-pixel paths of Adafruit_GFX and GxEPD2_3C, i.e., the default fillRect
+// and fillScreen of Adafruit_GFX on top of the drawPixel of GxEPD2_3C. First,
+// both are checked to give identical bit planes for random rectangles in
+// all rotations. Then each one clears the frame and stamps the 305 markers
+// of a P_AC curve for 200 frames, five runs each, and the mean time per
+// frame is printed. Build and run it from this folder by
+//   g++ -std=c++11 -Wall -O2 -pthread -Ihost -o frame_buffer_benchmark frame_buffer_benchmark.cpp && ./frame_buffer_benchmark
+
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../tri_color_frame_buffer.h"
+
+
+const int PANEL_WIDTH = 648;
+const int PANEL_HEIGHT = 480;
+const int FRAME_COUNT = 200;
+const int RUN_COUNT = 5;
+
+
+/// Frame buffer with the per-pixel drawing of GxEPD2_3C::drawPixel. All
+/// other drawing functions are the generic ones of Adafruit_GFX.
+class PerPixelFrameBuffer : public Adafruit_GFX {
+ public:
+  PerPixelFrameBuffer()
+  : Adafruit_GFX(PANEL_WIDTH, PANEL_HEIGHT),
+    blackPlane(PANEL_WIDTH / 8 * PANEL_HEIGHT, 0xFF),
+    redPlane(PANEL_WIDTH / 8 * PANEL_HEIGHT, 0xFF) {}
+
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (x < 0 || x >= width() || y < 0 || y >= height()) {
+      return;
+    }
+    int16_t t;
+    switch (getRotation()) {
+      case 1:
+        t = x;
+        x = WIDTH - 1 - y;
+        y = t;
+        break;
+      case 2:
+        x = WIDTH - 1 - x;
+        y = HEIGHT - 1 - y;
+        break;
+      case 3:
+        t = x;
+        x = y;
+        y = HEIGHT - 1 - t;
+        break;
+    }
+    uint32_t index = x / 8 + static_cast<uint32_t>(y) * (WIDTH / 8);
+    uint8_t mask = 1 << (7 - x % 8);
+    blackPlane[index] |= mask;
+    redPlane[index] |= mask;
+    if (color == TriColorFrameBuffer::WHITE) {
+      return;
+    } else if (color == TriColorFrameBuffer::RED) {
+      redPlane[index] &= ~mask;
+    } else {
+      blackPlane[index] &= ~mask;
+    }
+  }
+
+
+  const uint8_t* getBlackPlane() const {
+    return blackPlane.data();
+  }
+
+
+  const uint8_t* getRedPlane() const {
+    return redPlane.data();
+  }
+
+ private:
+  std::vector<uint8_t> blackPlane;
+  std::vector<uint8_t> redPlane;
+};
+
+
+/// Draws random rectangles and pixels into both frame buffers and returns
+/// true if their planes are identical.
+bool checkIdenticalPlanes(TriColorFrameBuffer& fast, PerPixelFrameBuffer& reference) {
+  const uint16_t COLORS[] = {TriColorFrameBuffer::BLACK, TriColorFrameBuffer::WHITE, TriColorFrameBuffer::RED};
+  srand(1);
+  for (int iteration = 0; iteration < 20000; ++iteration) {
+    int rotation = rand() % 4;
+    fast.setRotation(rotation);
+    reference.setRotation(rotation);
+    int16_t x = rand() % 700 - 30;
+    int16_t y = rand() % 700 - 30;
+    int16_t w = rand() % 100 + 1;
+    int16_t h = rand() % 60 + 1;
+    uint16_t color = COLORS[rand() % 3];
+    if (rand() % 50 == 0) {
+      x = -5;
+      w = 700;
+    }
+    fast.fillRect(x, y, w, h, color);
+    reference.Adafruit_GFX::fillRect(x, y, w, h, color);
+    if (rand() % 7 == 0) {
+      fast.drawPixel(x, y, color);
+      reference.drawPixel(x, y, color);
+    }
+  }
+  size_t planeSize = PANEL_WIDTH / 8 * PANEL_HEIGHT;
+  return memcmp(fast.getBlackPlane(), reference.getBlackPlane(), planeSize) == 0 &&
+         memcmp(fast.getRedPlane(), reference.getRedPlane(), planeSize) == 0;
+}
+
+
+/// Returns the mean time per frame in microseconds of clearing the frame
+/// and stamping the markers of a P_AC curve with the given functions.
+template <typename ClearFunc, typename StampFunc>
+double measureFrameMicros(ClearFunc clear, StampFunc stamp) {
+  double sumMicros = 0.0;
+  for (int run = 0; run < RUN_COUNT; ++run) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+      clear();
+      for (int x = 40; x < 345; ++x) {
+        stamp(x, 100 + (x + frame) % 50);
+      }
+    }
+    sumMicros += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  }
+  return sumMicros / (RUN_COUNT * FRAME_COUNT);
+}
+
+
+int main() {
+  TriColorFrameBuffer fast(PANEL_WIDTH, PANEL_HEIGHT);
+  PerPixelFrameBuffer reference;
+  if (!checkIdenticalPlanes(fast, reference)) {
+    printf("FAILED: the planes differ from the ones of the per-pixel path\n");
+    return 1;
+  }
+
+  fast.setRotation(2);
+  reference.setRotation(2);
+  double fastMicros = measureFrameMicros([&fast] {
+    fast.fillScreen(TriColorFrameBuffer::WHITE);
+  }, [&fast](int x, int y) {
+    fast.stampMarker(x, y, 3, TriColorFrameBuffer::BLACK);
+  });
+  double referenceMicros = measureFrameMicros([&reference] {
+    reference.Adafruit_GFX::fillScreen(TriColorFrameBuffer::WHITE);
+  }, [&reference](int x, int y) {
+    reference.Adafruit_GFX::fillRect(x - 1, y - 1, 3, 3, TriColorFrameBuffer::BLACK);
+  });
+
+  size_t planeSize = PANEL_WIDTH / 8 * PANEL_HEIGHT;
+  bool isIdentical = memcmp(fast.getBlackPlane(), reference.getBlackPlane(), planeSize) == 0 &&
+                     memcmp(fast.getRedPlane(), reference.getRedPlane(), planeSize) == 0;
+  printf("Identical planes: %s\n", isIdentical ? "yes" : "no");
+  printf("TriColorFrameBuffer: %.1f us per frame\n", fastMicros);
+  printf("Per-pixel paths:     %.1f us per frame\n", referenceMicros);
+  return isIdentical ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Host test of the renderer of the e-Ink display against golden frames.
+// Two inverters are simulated by reference feeds (cf. reference_feed.h),
+// from which the data is prepared like on the box (newest data, medians of
+// ThingSpeak, daily yields, grid anomalies). Frames at several times and
+// zoom levels are rendered with frame_renderer.h and the CRCs of their bit
+// planes are compared with golden/frame_crcs.txt. The program fails if any
+// frame differs. Since the host stand-ins (cf. folder host) draw no texts,
+// the CRCs differ from the ones logged by the box in replay mode. Each
+// frame is also rendered in BAND_COUNT bands by the band pipeline of the box
+// on a simulated panel and has to be identical to the full frame. The CPU
+// time of both ways of rendering is printed.
+//
+// Build and run it from this folder by
+//   g++ -std=c++11 -Wall -O2 -pthread -Ihost -o frame_render_test frame_render_test.cpp && ./frame_render_test
+// After a reviewed change of the renderer, rewrite the golden CRCs by
+//   ./frame_render_test --update
+// To look at the frames, write them as PNG files into an existing folder by
+//   ./frame_render_test --png <folder>
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <GxEPD2_3C.h>
+
+#include "../frame_renderer.h"
+#include "../simulated_panel.h"
+#include "png_writer.h"
+#include "reference_feed.h"
+
+
+const char* GOLDEN_CRCS_PATH = "golden/frame_crcs.txt";
+
+const int PANEL_WIDTH = 648;
+const int PANEL_HEIGHT = 480;
+const double MAX_DATA_AGE_SECONDS = 900.0;
+const long UPDATE_INTERVAL_SECONDS = 600;
+const double PAC_REFERENCE_WATTS = 600.0;
+const double SECOND_CHANNEL_PEAK_WATTS = 420.0;
+const int BAND_COUNT = 4;  // Cf. PIPELINED_BAND_COUNT of the sketch.
+
+// Frames are rendered at these zoom levels every FRAME_INTERVAL_SECONDS on
+// the last day of the feed.
+const int FRAME_ZOOMS[] = {1, 3, 4};
+const long FRAME_INTERVAL_SECONDS = 3 * 3600;
+
+
+/// One rendered frame with the CRC of its planes.
+struct FrameRecord {
+  int zoom;
+  long timestamp;
+  uint32_t crc;
+  bool isBandedIdentical;
+};
+
+
+/// Sums of the CPU time of rendering the frames as full frame and in bands.
+struct RenderTiming {
+  double fullFrameMicros = 0.0;
+  double bandedMicros = 0.0;
+};
+
+
+/// Returns the newest entry not after the given time, or nullptr if none.
+const ReferenceEntry* getNewestEntry(const std::vector<ReferenceEntry>& entries, time_t now) {
+  auto end = std::upper_bound(entries.begin(), entries.end(), now, [](time_t timestamp, const ReferenceEntry& entry) {
+    return timestamp < entry.timestamp;
+  });
+  return (end == entries.begin()) ? nullptr : &*(end - 1);
+}
+
+
+/// Returns the newest data of a channel like queryNewestData of the sketch.
+PVSingleData getNewestData(const std::vector<ReferenceEntry>& entries, time_t now) {
+  PVSingleData data;
+  const ReferenceEntry* entry = getNewestEntry(entries, now);
+  if (entry != nullptr) {
+    data.timestamp = entry->timestamp;
+    data.age = static_cast<double>(now - entry->timestamp);
+    data.pAC = entry->power;
+    data.uAC = entry->voltage;
+    data.frequency = entry->frequency;
+    data.temperature = entry->temperature;
+    data.efficiency = entry->efficiency;
+    data.totalYield = entry->totalYieldKWh;
+  }
+  data.assessQuality(MAX_DATA_AGE_SECONDS);
+  return data;
+}
+
+
+/// Returns the medians of the given field like ThingSpeak, i.e., over
+/// buckets aligned to multiples of the resolution and stamped with their
+/// start, within the range of the given zoom level before now.
+std::vector<PlotPoint> getMedianCurve(const std::vector<ReferenceEntry>& entries, time_t now, int zoom, int resolutionMinutes,
+                                      double ReferenceEntry::* field, bool isZeroMissing) {
+  time_t bucketSeconds = resolutionMinutes * 60L;
+  time_t start = now - ZOOM_TO_RANGE_MINUTES[zoom] * 60L;
+  std::vector<PlotPoint> result;
+  std::vector<double> values;
+  for (auto entry = entries.begin(); entry != entries.end() && entry->timestamp <= now;) {
+    if (entry->timestamp <= start) {
+      ++entry;
+      continue;
+    }
+    time_t bucketStart = (entry->timestamp / bucketSeconds) * bucketSeconds;
+    values.clear();
+    for (; entry != entries.end() && entry->timestamp <= now && entry->timestamp < bucketStart + bucketSeconds; ++entry) {
+      if (!std::isnan((*entry).*field)) {
+        values.push_back((*entry).*field);
+      }
+    }
+    double median = NAN;
+    if (!values.empty()) {
+      std::sort(values.begin(), values.end());
+      size_t middle = values.size() / 2;
+      median = (values.size() % 2 == 1) ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+    }
+    if (isZeroMissing && median == 0.0) {
+      median = NAN;
+    }
+    result.push_back({static_cast<double>(bucketStart), median});
+  }
+  return result;
+}
+
+
+/// Simulates the box with the given channels from the start of the feeds
+/// and renders the frames. The daily yields and the grid anomalies are
+/// updated every UPDATE_INTERVAL_SECONDS as on the box. The frames are
+/// written as PNG files into the given folder unless it is nullptr.
+std::vector<FrameRecord> renderFrames(const std::vector<std::vector<ReferenceEntry>>& channels, const char* pngFolder, RenderTiming& timing) {
+  // Like on the box, the clear-sky model gets the peak power of all channels.
+  ClearSkyModel clearSkyModel(48.78f, 9.18f, 30.0f, 180.0f, static_cast<float>(REFERENCE_PEAK_POWER_WATTS + SECOND_CHANNEL_PEAK_WATTS));
+  StreamingAnomalyDetector frequencyAnomalyDetector(49.8f, 50.2f, 0.05f, 4.0f, 0.01f, 20);
+  StreamingAnomalyDetector uacAnomalyDetector(207.0f, 253.0f, 0.05f, 4.0f, 0.5f, 20);
+  AnomalyEventLog anomalyLog;
+  DailyYieldHistory dailyYieldHistory;
+  FrameRenderer frameRenderer;
+  TriColorFrameBuffer frameBuffer(PANEL_WIDTH, PANEL_HEIGHT);
+  U8G2_FOR_ADAFRUIT_GFX u8g2Fonts;
+  u8g2Fonts.begin(frameBuffer);
+  TriColorDisplay<SimulatedPanel<GxEPD2_583c_Z83>> bandedDisplay((SimulatedPanel<GxEPD2_583c_Z83>()));
+  bandedDisplay.init();
+  bandedDisplay.enableBandPipeline(BAND_COUNT, 1);
+  U8G2_FOR_ADAFRUIT_GFX bandedU8g2Fonts;
+  bandedU8g2Fonts.begin(bandedDisplay);
+
+  std::vector<FrameRecord> frames;
+  time_t firstFrameTimestamp = REFERENCE_START_TIMESTAMP + (REFERENCE_DAY_COUNT - 1) * 86400L;
+  time_t end = REFERENCE_START_TIMESTAMP + REFERENCE_DAY_COUNT * 86400L;
+  time_t lastAnomalyCheckTimestamp = 0;
+  for (time_t now = REFERENCE_START_TIMESTAMP + UPDATE_INTERVAL_SECONDS; now < end; now += UPDATE_INTERVAL_SECONDS) {
+    std::vector<PVSingleData> channelData;
+    for (const std::vector<ReferenceEntry>& entries : channels) {
+      channelData.push_back(getNewestData(entries, now));
+    }
+    PVSingleData combinedData = combinePVData(channelData, NAN, MAX_DATA_AGE_SECONDS);
+    if (combinedData.quality.isValid(PV_FIELD_TOTAL_YIELD)) {
+      dailyYieldHistory.update(static_cast<int32_t>(now / (24 * 3600)), combinedData.totalYield);
+    }
+    std::vector<PlotPoint> dailyYields = dailyYieldHistory.getDailyYields();
+    if (!dailyYields.empty() && dailyYields.back().x == 0.0) {
+      combinedData.todayYield = dailyYields.back().y;
+      combinedData.quality.set(PV_FIELD_TODAY_YIELD, DataQualityFlags::assessValue(PV_FIELD_TODAY_YIELD, combinedData.todayYield,
+                                                                                   combinedData.age, MAX_DATA_AGE_SECONDS));
+    }
+    clearSkyModel.updateDay(now);
+
+    // Grid anomalies of the first channel, cf. checkGridAnomalies.
+    for (const ReferenceEntry& entry : channels.front()) {
+      if (entry.timestamp <= lastAnomalyCheckTimestamp || entry.timestamp > now) {
+        continue;
+      }
+      lastAnomalyCheckTimestamp = entry.timestamp;
+      AnomalyKind kind = frequencyAnomalyDetector.addSample(entry.frequency);
+      if (kind != AnomalyKind::NONE) {
+        anomalyLog.add({static_cast<uint32_t>(entry.timestamp), static_cast<float>(entry.frequency), ANOMALY_SOURCE_FREQUENCY, kind});
+      }
+      kind = uacAnomalyDetector.addSample(entry.voltage);
+      if (kind != AnomalyKind::NONE) {
+        anomalyLog.add({static_cast<uint32_t>(entry.timestamp), static_cast<float>(entry.voltage), ANOMALY_SOURCE_UAC, kind});
+      }
+    }
+
+    if (now < firstFrameTimestamp || (now - firstFrameTimestamp) % FRAME_INTERVAL_SECONDS != 0) {
+      continue;
+    }
+    for (int zoom : FRAME_ZOOMS) {
+      FrameData frameData;
+      gmtime_r(&now, &frameData.currentTime);
+      frameData.now = now;
+      frameData.zoom = zoom;
+      frameData.newestData = combinedData;
+      frameData.channelData = channelData;
+      for (const std::vector<ReferenceEntry>& entries : channels) {
+        frameData.pacCurves.push_back(getMedianCurve(entries, now, zoom, getPACResolutionMinutes(zoom), &ReferenceEntry::power, false));
+      }
+      frameData.uacCurve = getMedianCurve(channels.front(), now, zoom, ZOOM_TO_RESOLUTION_MINUTES[zoom], &ReferenceEntry::voltage, true);
+      frameData.frequencyCurve = getMedianCurve(channels.front(), now, zoom, ZOOM_TO_RESOLUTION_MINUTES[zoom], &ReferenceEntry::frequency, true);
+      frameData.dailyYields = dailyYields;
+      frameData.anomalyLog = &anomalyLog;
+      frameData.clearSkyModel = &clearSkyModel;
+      frameData.pacReferenceWatts = PAC_REFERENCE_WATTS;
+      frameData.gaugeModeLabel = "Leistung";
+      frameRenderer.prepare(frameData);
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      frameRenderer.render(frameBuffer, u8g2Fonts);
+      timing.fullFrameMicros += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+      // Like queryDataAndRedraw, the whole frame is rendered for each band,
+      // which is clipped to the rows of the band.
+      double bandedMicros = 0.0;
+      bandedDisplay.firstPage();
+      do {
+        start = std::chrono::steady_clock::now();
+        frameRenderer.render(bandedDisplay, bandedU8g2Fonts);
+        bandedMicros += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+      } while (bandedDisplay.nextPage());
+      timing.bandedMicros += bandedMicros;
+      bool isBandedIdentical = memcmp(frameBuffer.getBlackPlane(), bandedDisplay.getBlackPlane(), frameBuffer.getPlaneSize()) == 0 &&
+                               memcmp(frameBuffer.getRedPlane(), bandedDisplay.getRedPlane(), frameBuffer.getPlaneSize()) == 0;
+
+      uint32_t crc = updateCrc32(0, frameBuffer.getBlackPlane(), frameBuffer.getPlaneSize());
+      crc = updateCrc32(crc, frameBuffer.getRedPlane(), frameBuffer.getPlaneSize());
+      frames.push_back({zoom, static_cast<long>(now), crc, isBandedIdentical});
+
+      if (pngFolder != nullptr) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/frame_%02d_zoom%d.png", pngFolder, static_cast<int>(frames.size() - 1), zoom);
+        if (!writeTriColorPng(path, frameBuffer.getBlackPlane(), frameBuffer.getRedPlane(), PANEL_WIDTH, PANEL_HEIGHT, true)) {
+          printf("Could not write %s\n", path);
+        }
+      }
+    }
+  }
+  return frames;
+}
+
+
+/// Reads the golden CRCs, one frame per line as "<zoom> <timestamp> <crc>".
+/// Lines starting with '#' are skipped.
+std::vector<FrameRecord> loadGoldenCrcs() {
+  std::vector<FrameRecord> frames;
+  FILE* file = fopen(GOLDEN_CRCS_PATH, "r");
+  if (file == nullptr) {
+    return frames;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    FrameRecord frame;
+    unsigned int crc;
+    if (line[0] != '#' && sscanf(line, "%d %ld %x", &frame.zoom, &frame.timestamp, &crc) == 3) {
+      frame.crc = crc;
+      frames.push_back(frame);
+    }
+  }
+  fclose(file);
+  return frames;
+}
+
+
+bool saveGoldenCrcs(const std::vector<FrameRecord>& frames) {
+  FILE* file = fopen(GOLDEN_CRCS_PATH, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  fprintf(file, "# Golden CRCs of the frames of frame_render_test.cpp, one frame per line\n");
+  fprintf(file, "# as <zoom> <timestamp> <CRC of black and red plane>. Rewrite them only\n");
+  fprintf(file, "# after a reviewed change of the renderer by ./frame_render_test --update\n");
+  for (const FrameRecord& frame : frames) {
+    fprintf(file, "%d %ld %08x\n", frame.zoom, frame.timestamp, static_cast<unsigned>(frame.crc));
+  }
+  fclose(file);
+  return true;
+}
+
+
+int main(int argc, char* argv[]) {
+  bool isUpdate = (argc > 1 && strcmp(argv[1], "--update") == 0);
+  const char* pngFolder = (argc > 2 && strcmp(argv[1], "--png") == 0) ? argv[2] : nullptr;
+
+  // The second inverter is smaller and sees other clouds. A voltage peak and
+  // a frequency outlier are injected on the last day to show anomalies.
+  std::vector<std::vector<ReferenceEntry>> channels = {generateReferenceFeed(), generateReferenceFeed(7, SECOND_CHANNEL_PEAK_WATTS)};
+  time_t lastDay = REFERENCE_START_TIMESTAMP + (REFERENCE_DAY_COUNT - 1) * 86400L;
+  for (ReferenceEntry& entry : channels.front()) {
+    if (entry.timestamp == lastDay + 14 * 3600) {
+      entry.voltage = 249.0;
+    } else if (entry.timestamp == lastDay + 9 * 3600 + 30 * 60) {
+      entry.frequency = 50.15;
+    }
+  }
+
+  RenderTiming timing;
+  std::vector<FrameRecord> frames = renderFrames(channels, pngFolder, timing);
+  if (isUpdate) {
+    if (!saveGoldenCrcs(frames)) {
+      printf("Could not write %s\n", GOLDEN_CRCS_PATH);
+      return 1;
+    }
+    printf("Wrote %zu golden CRCs to %s\n", frames.size(), GOLDEN_CRCS_PATH);
+    return 0;
+  }
+
+  std::vector<FrameRecord> goldenFrames = loadGoldenCrcs();
+  int failureCount = 0;
+  for (size_t index = 0; index < frames.size(); ++index) {
+    if (!frames[index].isBandedIdentical) {
+      printf("FAILED: frame %zu (zoom %d at %ld) differs when rendered in %d bands\n", index, frames[index].zoom, frames[index].timestamp, BAND_COUNT);
+      ++failureCount;
+    }
+  }
+  printf("Rendering took %.0f us per frame as full frame and %.0f us in %d bands\n", timing.fullFrameMicros / frames.size(),
+         timing.bandedMicros / frames.size(), BAND_COUNT);
+  if (goldenFrames.size() != frames.size()) {
+    printf("FAILED: %zu frames rendered, but %zu golden CRCs in %s\n", frames.size(), goldenFrames.size(), GOLDEN_CRCS_PATH);
+    ++failureCount;
+  }
+  for (size_t index = 0; index < std::min(frames.size(), goldenFrames.size()); ++index) {
+    const FrameRecord& frame = frames[index];
+    const FrameRecord& golden = goldenFrames[index];
+    if (frame.zoom != golden.zoom || frame.timestamp != golden.timestamp || frame.crc != golden.crc) {
+      printf("FAILED: frame %zu (zoom %d at %ld) has CRC %08x instead of %08x\n", index, frame.zoom, frame.timestamp,
+             static_cast<unsigned>(frame.crc), static_cast<unsigned>(golden.crc));
+      ++failureCount;
+    }
+  }
+  printf("%s: %zu frames compared\n", (failureCount == 0) ? "PASSED" : "FAILED", frames.size());
+  return (failureCount == 0) ? 0 : 1;
+}
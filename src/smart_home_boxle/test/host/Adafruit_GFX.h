@@ -0,0 +1,180 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Minimal stand-in of the library 'Adafruit GFX' for the host programs in
+// the parent folder. The graphics primitives (lines, rectangles, rotation)
+// follow the algorithms of the library, so that the rendered frames are
+// pixel-identical to the ones on the box. Texts are not drawn at all since
+// the fonts are not available on the host, and their width is zero.
+
+#pragma once
+
+
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+#include <Arduino.h>
+
+
+struct GFXglyph {
+  uint16_t bitmapOffset;
+  uint8_t width;
+  uint8_t height;
+  uint8_t xAdvance;
+  int8_t xOffset;
+  int8_t yOffset;
+};
+
+
+struct GFXfont {
+  uint8_t* bitmap;
+  GFXglyph* glyph;
+  uint16_t first;
+  uint16_t last;
+  uint8_t yAdvance;
+};
+
+
+class Adafruit_GFX {
+ public:
+  Adafruit_GFX(int16_t w, int16_t h)
+  : WIDTH(w), HEIGHT(h), _width(w), _height(h) {}
+
+  virtual ~Adafruit_GFX() {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+  virtual void startWrite() {}
+
+  virtual void writePixel(int16_t x, int16_t y, uint16_t color) {
+    drawPixel(x, y, color);
+  }
+
+  virtual void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    drawFastVLine(x, y, h, color);
+  }
+
+  virtual void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    drawFastHLine(x, y, w, color);
+  }
+
+  virtual void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    fillRect(x, y, w, h, color);
+  }
+
+  /// Bresenham's algorithm as in Adafruit_GFX::writeLine.
+  virtual void writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    bool isSteep = abs(y1 - y0) > abs(x1 - x0);
+    if (isSteep) {
+      std::swap(x0, y0);
+      std::swap(x1, y1);
+    }
+    if (x0 > x1) {
+      std::swap(x0, x1);
+      std::swap(y0, y1);
+    }
+    int16_t dx = x1 - x0;
+    int16_t dy = abs(y1 - y0);
+    int16_t err = dx / 2;
+    int16_t yStep = (y0 < y1) ? 1 : -1;
+    for (; x0 <= x1; ++x0) {
+      if (isSteep) {
+        writePixel(y0, x0, color);
+      } else {
+        writePixel(x0, y0, color);
+      }
+      err -= dy;
+      if (err < 0) {
+        y0 += yStep;
+        err += dx;
+      }
+    }
+  }
+
+  virtual void endWrite() {}
+
+  virtual void setRotation(uint8_t r) {
+    rotation = r & 3;
+    _width = (rotation & 1) ? HEIGHT : WIDTH;
+    _height = (rotation & 1) ? WIDTH : HEIGHT;
+  }
+
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    startWrite();
+    writeLine(x, y, x, y + h - 1, color);
+    endWrite();
+  }
+
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    startWrite();
+    writeLine(x, y, x + w - 1, y, color);
+    endWrite();
+  }
+
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    startWrite();
+    for (int16_t i = x; i < x + w; ++i) {
+      writeFastVLine(i, y, h, color);
+    }
+    endWrite();
+  }
+
+  virtual void fillScreen(uint16_t color) {
+    fillRect(0, 0, _width, _height, color);
+  }
+
+  virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    if (x0 == x1) {
+      if (y0 > y1) {
+        std::swap(y0, y1);
+      }
+      drawFastVLine(x0, y0, y1 - y0 + 1, color);
+    } else if (y0 == y1) {
+      if (x0 > x1) {
+        std::swap(x0, x1);
+      }
+      drawFastHLine(x0, y0, x1 - x0 + 1, color);
+    } else {
+      startWrite();
+      writeLine(x0, y0, x1, y1, color);
+      endWrite();
+    }
+  }
+
+  virtual void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    startWrite();
+    writeFastHLine(x, y, w, color);
+    writeFastHLine(x, y + h - 1, w, color);
+    writeFastVLine(x, y, h, color);
+    writeFastVLine(x + w - 1, y, h, color);
+    endWrite();
+  }
+
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+  uint8_t getRotation() const { return rotation; }
+  void setCursor(int16_t x, int16_t y) {}
+  void setFont(const GFXfont* font) {}
+  void setTextColor(uint16_t color) {}
+
+  void getTextBounds(const String& text, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+    *x1 = x;
+    *y1 = y;
+    *w = 0;
+    *h = 0;
+  }
+
+  template <typename T>
+  size_t print(const T& value) { return 0; }
+
+ protected:
+  const int16_t WIDTH;
+  const int16_t HEIGHT;
+  int16_t _width;
+  int16_t _height;
+  uint8_t rotation = 0;
+};
@@ -0,0 +1,210 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Minimal stand-in of the Arduino core of the ESP32 for the host programs
+// in the parent folder. It provides the String class, the clock functions,
+// and the FreeRTOS primitives used by the sketch, the latter by threads,
+// mutexes, and condition variables of the standard library.
+
+#pragma once
+
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class String {
+ public:
+  String() {}
+  String(const char* text) : text(text) {}
+  String(const std::string& text) : text(text) {}
+  String(char c) : text(1, c) {}
+  String(int value) : text(std::to_string(value)) {}
+  String(unsigned int value) : text(std::to_string(value)) {}
+  String(long value) : text(std::to_string(value)) {}
+  String(unsigned long value) : text(std::to_string(value)) {}
+  String(float value, unsigned int decimalPlaces = 2) : String(static_cast<double>(value), decimalPlaces) {}
+
+  String(double value, unsigned int decimalPlaces = 2) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimalPlaces), value);
+    text = buffer;
+  }
+
+  const char* c_str() const { return text.c_str(); }
+  unsigned int length() const { return text.size(); }
+  String& operator+=(const String& other) { text += other.text; return *this; }
+  bool operator==(const String& other) const { return text == other.text; }
+  bool operator!=(const String& other) const { return text != other.text; }
+  char operator[](unsigned int index) const { return text[index]; }
+  bool startsWith(const String& prefix) const { return text.compare(0, prefix.text.size(), prefix.text) == 0; }
+  long toInt() const { return atol(text.c_str()); }
+
+  friend String operator+(const String& first, const String& second) { return String(first.text + second.text); }
+  friend String operator+(const char* first, const String& second) { return String(first + second.text); }
+  friend String operator+(const String& first, const char* second) { return String(first.text + second); }
+
+ private:
+  std::string text;
+};
+
+
+#define IRAM_ATTR
+
+
+inline unsigned long millis() {
+  static const std::chrono::steady_clock::time_point START = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - START).count();
+}
+
+
+inline unsigned long micros() {
+  static const std::chrono::steady_clock::time_point START = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - START).count();
+}
+
+
+inline void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+
+// FreeRTOS. Only waiting forever (portMAX_DELAY) and not waiting at all
+// are distinguished; any other timeout is waited in milliseconds.
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+
+
+struct HostQueue {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::vector<uint8_t>> items;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+};
+
+typedef HostQueue* QueueHandle_t;
+
+
+struct HostSemaphore {
+  std::mutex mutex;
+  std::condition_variable changed;
+  UBaseType_t count;
+  UBaseType_t maxCount;
+};
+
+typedef HostSemaphore* SemaphoreHandle_t;
+
+
+/// Waits on the given condition variable until the predicate holds or the
+/// timeout expires. Returns the predicate.
+template <typename Predicate>
+bool hostWait(std::condition_variable& changed, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate predicate) {
+  if (ticks == portMAX_DELAY) {
+    changed.wait(lock, predicate);
+    return true;
+  }
+  return changed.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), predicate);
+}
+
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HostQueue* queue = new HostQueue();
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!hostWait(queue->changed, lock, ticks, [queue] { return queue->items.size() < queue->length; })) {
+    return pdFALSE;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(item);
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!hostWait(queue->changed, lock, ticks, [queue] { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  HostSemaphore* semaphore = new HostSemaphore();
+  semaphore->count = initialCount;
+  semaphore->maxCount = maxCount;
+  return semaphore;
+}
+
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return xSemaphoreCreateCounting(1, 1);
+}
+
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  if (!hostWait(semaphore->changed, lock, ticks, [semaphore] { return semaphore->count > 0; })) {
+    return pdFALSE;
+  }
+  --semaphore->count;
+  return pdTRUE;
+}
+
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  if (semaphore->count >= semaphore->maxCount) {
+    return pdFALSE;
+  }
+  ++semaphore->count;
+  semaphore->changed.notify_all();
+  return pdTRUE;
+}
+
+
+/// Runs the given task function in a detached thread. Priority and core
+/// are ignored.
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                          UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  std::thread(function, parameter).detach();
+  if (handle != nullptr) {
+    *handle = nullptr;
+  }
+  return pdPASS;
+}
@@ -0,0 +1,12 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Empty stand-in of the font FreeSans9pt7b of Adafruit GFX, cf. ../Adafruit_GFX.h.
+
+#pragma once
+
+
+const GFXfont FreeSans9pt7b = {nullptr, nullptr, 0, 0, 0};
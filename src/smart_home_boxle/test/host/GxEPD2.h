@@ -0,0 +1,27 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Minimal stand-in of the base header of the library 'GxEPD2' for the host
+// programs in the parent folder, i.e., the color codes and the panel types
+// used by the sketch.
+
+#pragma once
+
+
+#include <Arduino.h>
+
+
+#define GxEPD_BLACK 0x0000
+#define GxEPD_WHITE 0xFFFF
+#define GxEPD_RED 0xF800
+
+
+class GxEPD2 {
+ public:
+  enum Panel {
+    GDEQ0583Z31
+  };
+};
@@ -0,0 +1,33 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Minimal stand-in of the library 'GxEPD2' for the host programs in the
+// parent folder. The driver of the panel of the box provides only the size
+// and the timing constants, e.g., for SimulatedPanel. It cannot be used to
+// drive a panel.
+
+#pragma once
+
+
+#include <GxEPD2.h>
+
+
+class GxEPD2_583c_Z83 {
+ public:
+  static const uint16_t WIDTH = 648;
+  static const uint16_t WIDTH_VISIBLE = WIDTH;
+  static const uint16_t HEIGHT = 480;
+  static const GxEPD2::Panel panel = GxEPD2::GDEQ0583Z31;
+  static const bool hasColor = true;
+  static const bool hasPartialUpdate = true;
+  static const bool hasFastPartialUpdate = false;
+  static const uint16_t power_on_time = 100;  // ms
+  static const uint16_t power_off_time = 250;  // ms
+  static const uint16_t full_refresh_time = 27000;  // ms
+  static const uint16_t partial_refresh_time = 27000;  // ms
+
+  GxEPD2_583c_Z83(int16_t cs, int16_t dc, int16_t rst, int16_t busy) {}
+};
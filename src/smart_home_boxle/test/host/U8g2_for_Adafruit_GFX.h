@@ -0,0 +1,33 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Minimal stand-in of the library 'U8g2_for_Adafruit_GFX' for the host
+// programs in the parent folder. Like in Adafruit_GFX.h, texts are not drawn
+// and their width is zero.
+
+#pragma once
+
+
+#include <cstdint>
+
+#include <Adafruit_GFX.h>
+
+
+const uint8_t u8g2_font_logisoso92_tn[1] = {0};
+
+
+class U8G2_FOR_ADAFRUIT_GFX {
+ public:
+  void begin(Adafruit_GFX& gfx) {}
+  void setFont(const uint8_t* font) {}
+  void setCursor(int16_t x, int16_t y) {}
+  void setForegroundColor(uint16_t color) {}
+  void setBackgroundColor(uint16_t color) {}
+  int16_t getUTF8Width(const char* text) { return 0; }
+
+  template <typename T>
+  size_t print(const T& value) { return 0; }
+};
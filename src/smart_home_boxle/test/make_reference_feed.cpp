@@ -0,0 +1,41 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Generates the reference feed of reference_feed.h, i.e., five days of
+// synthetic inverter data in one-minute steps, in the format of the
+// ThingSpeak feeds API, e.g., for the replay mode or for
+// pac_forecast_backtest.cpp. The feed is fully deterministic, so that it needs
+// not be committed. Build and run it from this folder by
+//   g++ -std=c++11 -Wall -o make_reference_feed make_reference_feed.cpp && ./make_reference_feed > reference.json
+
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+#include "reference_feed.h"
+
+
+int main() {
+  printf("{\"channel\":{\"id\":0,\"name\":\"Reference\"},\"feeds\":[");
+  for (const ReferenceEntry& entry : generateReferenceFeed()) {
+    tm time;
+    gmtime_r(&entry.timestamp, &time);
+    char text[24];
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &time);
+    printf("%s{\"created_at\":\"%s\",\"entry_id\":%ld", (entry.timestamp == REFERENCE_START_TIMESTAMP) ? "" : ",", text,
+           static_cast<long>((entry.timestamp - REFERENCE_START_TIMESTAMP) / REFERENCE_STEP_SECONDS + 1));
+    printf(",\"field1\":\"%.1f\",\"field2\":\"%.3f\"", entry.voltage, entry.frequency);
+    if (entry.power > 0.0) {
+      printf(",\"field3\":\"%.1f\",\"field4\":\"%.1f\",\"field5\":\"%.1f\"", entry.power, entry.temperature, entry.efficiency);
+    } else {
+      printf(",\"field3\":\"0.0\",\"field4\":null,\"field5\":null");
+    }
+    printf(",\"field6\":\"%.3f\"}", entry.totalYieldKWh);
+  }
+  printf("]}\n");
+  return 0;
+}
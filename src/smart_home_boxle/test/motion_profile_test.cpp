@@ -0,0 +1,98 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Host test of the motion timing of MotionProfile. Build and run it from
+// this folder by
+//   g++ -std=c++11 -Wall -o motion_profile_test motion_profile_test.cpp && ./motion_profile_test
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../motion_profile.h"
+
+
+const float MAX_VELOCITY = 1.0f;
+const float ACCELERATION = 4.0f;
+const float DT_SECONDS = 0.001f;
+
+int failureCount = 0;
+
+
+void check(bool condition, const char* message) {
+  if (!condition) {
+    printf("FAILED: %s\n", message);
+    ++failureCount;
+  }
+}
+
+
+/// Moves the given profile to the given target and checks the acceleration
+/// and velocity limits as well as the overshoot on the way. Returns the
+/// time until the profile rests at the target.
+float moveAndCheck(MotionProfile& profile, float target) {
+  float start = profile.getPosition();
+  float direction = (target > start) ? 1.0f : -1.0f;
+  float previousVelocity = profile.getVelocity();
+  profile.setTarget(target);
+  float seconds = 0.0f;
+  while (!profile.isAtTarget() && seconds < 10.0f) {
+    profile.update(DT_SECONDS);
+    seconds += DT_SECONDS;
+    check(std::fabs(profile.getVelocity()) <= MAX_VELOCITY + 1e-6f, "velocity limit");
+    // On arrival, the needle stops from the last discrete speed step.
+    float maxVelocityChange = (profile.isAtTarget() ? 2.0f : 1.0f) * ACCELERATION * DT_SECONDS;
+    check(std::fabs(profile.getVelocity() - previousVelocity) <= maxVelocityChange + 1e-5f, "acceleration limit");
+    check((profile.getPosition() - target) * direction <= 1e-6f, "no overshoot");
+    previousVelocity = profile.getVelocity();
+  }
+  check(profile.isAtTarget(), "arrival");
+  return seconds;
+}
+
+
+/// Returns the arrival time of a trapezoidal (or triangular) profile from
+/// rest to rest over the given distance.
+float getExpectedSeconds(float distance) {
+  float accelerationDistance = MAX_VELOCITY * MAX_VELOCITY / ACCELERATION;  // For accelerating and decelerating.
+  if (distance < accelerationDistance) {
+    return 2.0f * std::sqrt(distance / ACCELERATION);
+  }
+  return 2.0f * MAX_VELOCITY / ACCELERATION + (distance - accelerationDistance) / MAX_VELOCITY;
+}
+
+
+int main() {
+  MotionProfile profile(MAX_VELOCITY, ACCELERATION);
+  const float TARGETS[] = {0.8f, 0.7f, 0.1f, 1.0f, 0.0f};
+  for (float target : TARGETS) {
+    float expectedSeconds = getExpectedSeconds(std::fabs(target - profile.getPosition()));
+    float seconds = moveAndCheck(profile, target);
+    printf("Move to %.2f took %.3f s, expected %.3f s.\n", target, seconds, expectedSeconds);
+    check(std::fabs(seconds - expectedSeconds) <= 0.02f, "arrival time");
+  }
+
+  // Reversal during a move, the needle must stop before moving back.
+  profile.setTarget(1.0f);
+  for (int count = 0; count < 200; ++count) {
+    profile.update(DT_SECONDS);
+  }
+  float reversalPosition = profile.getPosition();
+  float reversalVelocity = profile.getVelocity();
+  profile.setTarget(0.0f);
+  float maxPosition = 0.0f;
+  while (!profile.isAtTarget()) {
+    profile.update(DT_SECONDS);
+    maxPosition = std::max(maxPosition, profile.getPosition());
+  }
+  float expectedMaxPosition = reversalPosition + reversalVelocity * reversalVelocity / (2.0f * ACCELERATION);
+  printf("Reversal at %.3f went up to %.3f, expected %.3f.\n", reversalPosition, maxPosition, expectedMaxPosition);
+  check(std::fabs(maxPosition - expectedMaxPosition) <= 0.005f, "stopping distance on reversal");
+
+  printf((failureCount == 0) ? "All checks passed.\n" : "%d checks failed.\n", failureCount);
+  return (failureCount == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Host backtest of the P_AC forecaster on a recorded feed in the format of
+// the ThingSpeak feeds API (cf. README). Build and run it from this folder by
+//   g++ -std=c++11 -Wall -o pac_forecast_backtest pac_forecast_backtest.cpp && ./pac_forecast_backtest <feed.json> [<update interval in s>]
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "../pac_forecaster.h"
+
+
+/// Returns the text of the given key in the given entry, without the quotes
+/// of strings, or an empty string if the key is missing or null.
+std::string getValueText(const std::string& entry, const std::string& key) {
+  size_t start = entry.find("\"" + key + "\":");
+  if (start == std::string::npos) {
+    return "";
+  }
+  start += key.length() + 3;
+  if (entry.compare(start, 4, "null") == 0) {
+    return "";
+  }
+  if (entry[start] == '"') {
+    ++start;
+    return entry.substr(start, entry.find('"', start) - start);
+  }
+  return entry.substr(start, entry.find_first_of(",}", start) - start);
+}
+
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s <feed.json> [<update interval in s>]\n", argv[0]);
+    return 2;
+  }
+  std::ifstream file(argv[1]);
+  std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  size_t position = json.find("\"feeds\":[");
+  if (!file || position == std::string::npos) {
+    printf("Could not read the feeds of %s.\n", argv[1]);
+    return 1;
+  }
+  double updateIntervalSeconds = (argc > 2) ? atof(argv[2]) : 180.0;
+
+  // The entries of the feed are flat objects, i.e., each ends at the first '}'.
+  PacForecastBacktest backtest(PacForecaster(), updateIntervalSeconds);
+  long sampleCount = 0;
+  while ((position = json.find('{', position)) != std::string::npos) {
+    size_t end = json.find('}', position);
+    std::string entry = json.substr(position, end - position + 1);
+    position = end;
+
+    tm time = {};
+    std::string createdAt = getValueText(entry, "created_at");
+    std::string pAC = getValueText(entry, "field3");
+    if (createdAt.empty() || strptime(createdAt.c_str(), "%Y-%m-%dT%H:%M:%SZ", &time) == nullptr) {
+      continue;
+    }
+    backtest.addSample(static_cast<double>(timegm(&time)), pAC.empty() ? NAN : strtof(pAC.c_str(), nullptr));
+    ++sampleCount;
+  }
+
+  printf("%ld samples, %ld compared with an update interval of %.0f s\n", sampleCount, backtest.getComparedCount(), updateIntervalSeconds);
+  printf("Forecast: MAE %.1f W, RMSE %.1f W\n", backtest.getForecastMae(), backtest.getForecastRmse());
+  printf("Holding:  MAE %.1f W, RMSE %.1f W\n", backtest.getHoldMae(), backtest.getHoldRmse());
+  return 0;
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Host test of the P_AC forecaster with the clear-sky model as upper bound.
+// Build and run it from this folder by
+//   g++ -std=c++11 -Wall -o pac_forecaster_test pac_forecaster_test.cpp && ./pac_forecaster_test
+
+
+#include <cmath>
+#include <cstdio>
+
+#include "../clear_sky_model.h"
+#include "../pac_forecaster.h"
+
+
+const time_t DAY_START = 1718496000;  // 2024-06-16T00:00:00Z
+const float MARGIN = 1.2f;
+
+int failureCount = 0;
+
+
+void check(bool condition, const char* message) {
+  if (!condition) {
+    printf("FAILED: %s\n", message);
+    ++failureCount;
+  }
+}
+
+
+/// Returns a forecaster bounded by the clear-sky model of a system with
+/// 800 Wp in Stuttgart, i.e., the default location.
+PacForecaster makeBoundedForecaster(ClearSkyModel& model) {
+  model.updateDay(DAY_START);
+  PacForecaster forecaster;
+  forecaster.setUpperBound([&model](double timestamp) {
+    return MARGIN * model.getExpectedWatts(static_cast<time_t>(timestamp));
+  });
+  return forecaster;
+}
+
+
+void testSampleAboveBound() {
+  ClearSkyModel model(48.78f, 9.18f, 30.0f, 180.0f, 800.0f);
+  PacForecaster forecaster = makeBoundedForecaster(model);
+  double noon = DAY_START + 12 * 3600.0;
+  forecaster.addSample(noon - 180.0, 1100.0f);
+  forecaster.addSample(noon, 1200.0f);
+  check(forecaster.getForecast(noon) == 1200.0f, "above bound: sample is not clipped");
+  check(forecaster.getForecast(noon + 120.0) == 1200.0f, "above bound: rise is limited to the sample");
+}
+
+
+void testEveningSample() {
+  ClearSkyModel model(48.78f, 9.18f, 30.0f, 180.0f, 800.0f);
+  PacForecaster forecaster = makeBoundedForecaster(model);
+  double evening = DAY_START + 19 * 3600.0 + 1800.0;
+  forecaster.addSample(evening, 60.0f);
+  check(forecaster.getForecast(evening) == 60.0f, "evening: sample is kept although the model expects nothing");
+  check(forecaster.getForecast(evening + 300.0) == 60.0f, "evening: forecast does not drop below the sample");
+}
+
+
+void testRiseLimitedByBound() {
+  ClearSkyModel model(48.78f, 9.18f, 30.0f, 180.0f, 800.0f);
+  PacForecaster forecaster = makeBoundedForecaster(model);
+  double morning = DAY_START + 8 * 3600.0;
+  float bound = MARGIN * model.getExpectedWatts(static_cast<time_t>(morning + 600.0));
+  forecaster.addSample(morning - 180.0, 0.0f);
+  forecaster.addSample(morning, 0.9f * bound);
+  float forecast = forecaster.getForecast(morning + 600.0);
+  check(forecast > 0.9f * bound, "rise: rising trend is extrapolated");
+  check(forecast <= bound + 0.01f, "rise: extrapolation is limited by the bound");
+}
+
+
+void testUnbounded() {
+  PacForecaster forecaster;
+  forecaster.addSample(1000.0, 500.0f);
+  forecaster.addSample(1180.0, 600.0f);
+  check(forecaster.getForecast(1180.0) == 600.0f, "unbounded: forecast at the update is the sample");
+  check(forecaster.getForecast(1300.0) > 600.0f, "unbounded: rising trend is extrapolated");
+}
+
+
+int main() {
+  testSampleAboveBound();
+  testEveningSample();
+  testRiseLimitedByBound();
+  testUnbounded();
+  if (failureCount > 0) {
+    printf("%d checks failed.\n", failureCount);
+    return 1;
+  }
+  printf("All checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Minimal writer of PNG files for the host programs in this folder, e.g.,
+// to look at the rendered frames. The image data is stored uncompressed
+// (deflate blocks of type 0), so that no zlib is needed.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+
+/// Returns the CRC-32 (as by zlib and crc32_le of the ESP32 ROM) of the
+/// given bytes continuing the given CRC.
+inline uint32_t updateCrc32(uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  for (size_t index = 0; index < length; ++index) {
+    crc ^= data[index];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
+
+
+inline void appendBigEndian32(std::vector<uint8_t>& bytes, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    bytes.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+
+/// Appends a chunk of the given type and data with its length and CRC.
+inline void appendPngChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data) {
+  appendBigEndian32(png, data.size());
+  size_t typeStart = png.size();
+  png.insert(png.end(), type, type + 4);
+  png.insert(png.end(), data.begin(), data.end());
+  appendBigEndian32(png, updateCrc32(0, png.data() + typeStart, png.size() - typeStart));
+}
+
+
+/// Writes the given bit planes of a black/white/red frame (in the layout of
+/// TriColorFrameBuffer) as PNG with a palette of these three colors. If
+/// isUpsideDown is set, the frame is rotated by 180 degrees, e.g., to show
+/// it as seen on the box with rotation 2. Returns false on a write error.
+inline bool writeTriColorPng(const char* path, const uint8_t* blackPlane, const uint8_t* redPlane, int width, int height, bool isUpsideDown) {
+  // Rows of two bits per pixel, each preceded by filter type 0.
+  size_t rowBytes = (width + 3) / 4;
+  std::vector<uint8_t> raw;
+  raw.reserve((rowBytes + 1) * height);
+  for (int y = 0; y < height; ++y) {
+    raw.push_back(0);
+    size_t rowStart = raw.size();
+    raw.resize(rowStart + rowBytes, 0);
+    for (int x = 0; x < width; ++x) {
+      int sourceX = isUpsideDown ? width - 1 - x : x;
+      int sourceY = isUpsideDown ? height - 1 - y : y;
+      uint32_t bit = static_cast<uint32_t>(sourceY) * width + sourceX;
+      uint8_t mask = 0x80 >> (bit & 7);
+      uint8_t colorIndex = 0;  // White.
+      if ((redPlane[bit / 8] & mask) == 0) {
+        colorIndex = 2;
+      } else if ((blackPlane[bit / 8] & mask) == 0) {
+        colorIndex = 1;
+      }
+      raw[rowStart + x / 4] |= colorIndex << (6 - 2 * (x % 4));
+    }
+  }
+
+  // zlib stream of stored deflate blocks with the Adler-32 checksum.
+  std::vector<uint8_t> zlib = {0x78, 0x01};
+  for (size_t offset = 0; offset < raw.size() || offset == 0; offset += 65535) {
+    size_t length = std::min<size_t>(raw.size() - offset, 65535);
+    zlib.push_back((offset + length == raw.size()) ? 1 : 0);
+    zlib.push_back(length & 0xFF);
+    zlib.push_back(length >> 8);
+    zlib.push_back(~length & 0xFF);
+    zlib.push_back((~length >> 8) & 0xFF);
+    zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+  }
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (uint8_t byte : raw) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  appendBigEndian32(zlib, (b << 16) | a);
+
+  std::vector<uint8_t> header;
+  appendBigEndian32(header, width);
+  appendBigEndian32(header, height);
+  header.insert(header.end(), {2, 3, 0, 0, 0});  // Bit depth 2, palette, deflate, no filter, no interlace.
+  std::vector<uint8_t> palette = {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00};
+
+  std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  appendPngChunk(png, "IHDR", header);
+  appendPngChunk(png, "PLTE", palette);
+  appendPngChunk(png, "IDAT", zlib);
+  appendPngChunk(png, "IEND", std::vector<uint8_t>());
+
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool isWritten = fwrite(png.data(), 1, png.size(), file) == png.size();
+  return (fclose(file) == 0) && isWritten;
+}
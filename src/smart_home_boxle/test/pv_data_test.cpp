@@ -0,0 +1,144 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Host test of the combination of the newest data of several channels and
+// of the P_AC forecast fed with it. Build and run it from this folder by
+//   g++ -std=c++11 -Wall -o pv_data_test pv_data_test.cpp && ./pv_data_test
+
+
+#include <cmath>
+#include <cstdio>
+
+#include "../pac_forecaster.h"
+#include "../pv_data.h"
+
+
+const double MAX_AGE_SECONDS = 900.0;
+
+int failureCount = 0;
+
+
+void check(bool condition, const char* message) {
+  if (!condition) {
+    printf("FAILED: %s\n", message);
+    ++failureCount;
+  }
+}
+
+
+/// Returns the data of a channel reported at the given timestamp, as seen
+/// at the given current time.
+PVSingleData makeChannelData(time_t now, time_t timestamp, float pAC, float totalYield) {
+  PVSingleData data;
+  data.timestamp = timestamp;
+  data.age = static_cast<double>(now - timestamp);
+  data.pAC = pAC;
+  data.uAC = 230.0f;
+  data.frequency = 50.0f;
+  data.temperature = 40.0f;
+  data.efficiency = 95.0f;
+  data.totalYield = totalYield;
+  data.assessQuality(MAX_AGE_SECONDS);
+  return data;
+}
+
+
+void testAllFresh() {
+  time_t now = 100000;
+  std::vector<PVSingleData> channels{makeChannelData(now, now - 60, 500.0f, 1000.0f), makeChannelData(now, now - 120, 300.0f, 2000.0f)};
+  PVSingleData combined = combinePVData(channels, NAN, MAX_AGE_SECONDS);
+  check(combined.quality.isFresh(PV_FIELD_PAC), "all fresh: P_AC is fresh");
+  check(combined.pAC == 800.0f, "all fresh: P_AC is the sum");
+  check(combined.age == 120.0, "all fresh: age is the one of the oldest channel");
+  check(combined.timestamp == now - 60, "all fresh: timestamp is the one of the newest channel");
+  check(combined.totalYield == 3000.0f, "all fresh: total yield is the sum");
+}
+
+
+void testOneStale() {
+  time_t now = 100000;
+  std::vector<PVSingleData> channels{makeChannelData(now, now - 60, 500.0f, 1000.0f), makeChannelData(now, now - 5000, 300.0f, 2000.0f)};
+  PVSingleData combined = combinePVData(channels, NAN, MAX_AGE_SECONDS);
+  check(combined.quality.isFresh(PV_FIELD_PAC), "one stale: P_AC is fresh");
+  check(combined.pAC == 500.0f, "one stale: P_AC of the stale channel is not added");
+  check(combined.age == 60.0, "one stale: age is the one of the fresh channel");
+  check(combined.timestamp == now - 60, "one stale: timestamp is the one of the fresh channel");
+  check(combined.totalYield == 3000.0f, "one stale: total yield is the sum");
+}
+
+
+void testAllStale() {
+  time_t now = 100000;
+  std::vector<PVSingleData> channels{makeChannelData(now, now - 4000, 500.0f, 1000.0f), makeChannelData(now, now - 5000, 300.0f, 2000.0f)};
+  PVSingleData combined = combinePVData(channels, NAN, MAX_AGE_SECONDS);
+  check(combined.quality.get(PV_FIELD_PAC) == DataQuality::STALE, "all stale: P_AC is stale");
+  check(combined.pAC == 800.0f, "all stale: P_AC is the sum");
+  check(combined.age == 5000.0, "all stale: age is the one of the oldest channel");
+}
+
+
+void testMissing() {
+  time_t now = 100000;
+  std::vector<PVSingleData> channels{makeChannelData(now, now - 60, NAN, 1000.0f), makeChannelData(now, now - 60, NAN, NAN)};
+  PVSingleData combined = combinePVData(channels, NAN, MAX_AGE_SECONDS);
+  check(combined.quality.get(PV_FIELD_PAC) == DataQuality::MISSING, "missing: P_AC is missing");
+  check(std::isnan(combined.pAC), "missing: P_AC is NaN");
+  check(combined.totalYield == 1000.0f, "missing: total yield of the reporting channel");
+}
+
+
+void testNotReportedYet() {
+  time_t now = 100000;
+  PVSingleData notReported = makeChannelData(now, now - 60, 500.0f, 0.0f);
+  check(notReported.quality.get(PV_FIELD_PAC) == DataQuality::INVALID, "not reported yet: P_AC is invalid");
+  check(notReported.quality.get(PV_FIELD_UAC) == DataQuality::INVALID, "not reported yet: U_AC is invalid");
+  check(notReported.quality.get(PV_FIELD_TOTAL_YIELD) == DataQuality::INVALID, "not reported yet: total yield is invalid");
+
+  std::vector<PVSingleData> channels{notReported, makeChannelData(now, now - 120, 300.0f, 2000.0f)};
+  PVSingleData combined = combinePVData(channels, NAN, MAX_AGE_SECONDS);
+  check(combined.quality.isFresh(PV_FIELD_PAC), "one not reported yet: P_AC is fresh");
+  check(combined.pAC == 300.0f, "one not reported yet: P_AC of the other channel only");
+  check(combined.totalYield == 2000.0f, "one not reported yet: total yield of the other channel only");
+
+  channels = {notReported, makeChannelData(now, now - 120, 300.0f, NAN)};
+  combined = combinePVData(channels, NAN, MAX_AGE_SECONDS);
+  check(!combined.quality.isValid(PV_FIELD_PAC), "none reported yet: P_AC is not shown");
+}
+
+
+/// Feeds the forecaster with the combined data of a fresh and a stale
+/// channel like the long-running task does and checks that each update
+/// reaches the forecaster.
+void testForecastWithStaleChannel() {
+  const time_t STALE_TIMESTAMP = 90000;
+  PacForecaster forecaster;
+  for (int update = 0; update < 10; ++update) {
+    time_t now = 100000 + update * 180;
+    float pAC = 400.0f + 10.0f * update;
+    std::vector<PVSingleData> channels{makeChannelData(now, now - 30, pAC, 1000.0f), makeChannelData(now, STALE_TIMESTAMP, 300.0f, 2000.0f)};
+    PVSingleData combined = combinePVData(channels, NAN, MAX_AGE_SECONDS);
+    if (combined.quality.isFresh(PV_FIELD_PAC)) {
+      forecaster.addSample(static_cast<double>(combined.timestamp), combined.pAC);
+    }
+    check(std::fabs(forecaster.getForecast(static_cast<double>(now - 30)) - pAC) < 0.01f, "stale channel: forecaster follows the fresh channel");
+  }
+}
+
+
+int main() {
+  testAllFresh();
+  testOneStale();
+  testAllStale();
+  testMissing();
+  testNotReportedYet();
+  testForecastWithStaleChannel();
+  if (failureCount > 0) {
+    printf("%d checks failed.\n", failureCount);
+    return 1;
+  }
+  printf("All checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Synthetic inverter data for the host programs in this folder, i.e., five
+// days of one-minute samples with a daily sun curve, drifting clouds (a
+// clearer sky each day), and noisy grid values. The data is fully
+// deterministic for a given seed.
+
+#pragma once
+
+
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+
+const time_t REFERENCE_START_TIMESTAMP = 1718496000;  // 2024-06-16T00:00:00Z
+const int REFERENCE_DAY_COUNT = 5;
+const int REFERENCE_STEP_SECONDS = 60;
+const double REFERENCE_PEAK_POWER_WATTS = 780.0;
+
+
+/// One sample of the reference feed. Temperature and efficiency are NaN
+/// while the inverter does not feed in.
+struct ReferenceEntry {
+  time_t timestamp;
+  double voltage;
+  double frequency;
+  double power;
+  double temperature;
+  double efficiency;
+  double totalYieldKWh;
+};
+
+
+/// Returns the next value of a linear congruential generator in [0, 1).
+inline double nextRandom(uint32_t& state) {
+  state = state * 1664525u + 1013904223u;
+  return (state >> 8) / 16777216.0;
+}
+
+
+/// Generates the reference feed for the given seed and peak power.
+inline std::vector<ReferenceEntry> generateReferenceFeed(uint32_t seed = 42, double peakPowerWatts = REFERENCE_PEAK_POWER_WATTS) {
+  std::vector<ReferenceEntry> entries;
+  uint32_t randomState = seed;
+  double cloudFactor = 1.0;
+  double totalYieldKWh = 1234.0;
+  for (time_t timestamp = REFERENCE_START_TIMESTAMP; timestamp < REFERENCE_START_TIMESTAMP + REFERENCE_DAY_COUNT * 86400L;
+       timestamp += REFERENCE_STEP_SECONDS) {
+    double hours = (timestamp % 86400L) / 3600.0;
+    double sunElevation = std::sin(M_PI * (hours - 4.0) / 16.0);
+
+    // Clouds drift slowly, with a different weather each day.
+    int day = static_cast<int>((timestamp - REFERENCE_START_TIMESTAMP) / 86400L);
+    double clearness = 1.0 - 0.15 * day;
+    cloudFactor += 0.1 * (clearness - cloudFactor) + 0.08 * (nextRandom(randomState) - 0.5);
+    cloudFactor = std::fmin(std::fmax(cloudFactor, 0.1), 1.0);
+
+    ReferenceEntry entry;
+    entry.timestamp = timestamp;
+    entry.power = (sunElevation > 0.0) ? peakPowerWatts * std::pow(sunElevation, 1.2) * cloudFactor : 0.0;
+    totalYieldKWh += entry.power * REFERENCE_STEP_SECONDS / 3.6e6;
+    entry.totalYieldKWh = totalYieldKWh;
+    entry.voltage = 231.0 + 2.0 * std::sin(2.0 * M_PI * hours / 24.0) + 0.6 * (nextRandom(randomState) - 0.5);
+    entry.frequency = 50.0 + 0.03 * std::sin(2.0 * M_PI * hours / 3.0) + 0.02 * (nextRandom(randomState) - 0.5);
+    entry.temperature = (entry.power > 0.0) ? 25.0 + 0.03 * entry.power : NAN;
+    entry.efficiency = (entry.power > 0.0) ? 93.0 + 2.0 * entry.power / peakPowerWatts : NAN;
+    entries.push_back(entry);
+  }
+  return entries;
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Host test of TriColorDisplay on a SimulatedPanel of the panel of the box
+// (cf. HAS_SIMULATED_PANEL of the sketch). A frame is drawn as a single
+// page and with the band pipeline, whose transfer task runs as a thread of
+// the host stand-ins of FreeRTOS. The recorded window writes, refreshes,
+// and power cycles are checked against the model of the panel, and both
+// frames must have identical planes. Build and run it from this folder by
+//   g++ -std=c++11 -Wall -O2 -pthread -Ihost -o simulated_panel_test simulated_panel_test.cpp && ./simulated_panel_test
+
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <GxEPD2_3C.h>
+
+#include "../simulated_panel.h"
+#include "../tri_color_frame_buffer.h"
+
+
+typedef SimulatedPanel<GxEPD2_583c_Z83> BoxlePanel;
+
+const uint32_t PLANE_SIZE = BoxlePanel::WIDTH / 8 * BoxlePanel::HEIGHT;
+const uint32_t FRAME_BYTES = 2 * PLANE_SIZE;
+
+int failureCount = 0;
+
+
+void check(bool condition, const char* message) {
+  if (!condition) {
+    printf("FAILED: %s\n", message);
+    ++failureCount;
+  }
+}
+
+
+/// Renders a frame with some shapes in all three colors in the paging loop
+/// of the sketch and powers off the panel.
+void renderFrame(TriColorDisplay<BoxlePanel>& display) {
+  display.setRotation(2);
+  display.setFullWindow();
+  display.firstPage();
+  do {
+    display.fillScreen(TriColorFrameBuffer::WHITE);
+    display.drawRect(10, 10, 628, 460, TriColorFrameBuffer::BLACK);
+    display.fillRect(40, 100, 300, 250, TriColorFrameBuffer::RED);
+    display.drawLine(0, 0, 647, 479, TriColorFrameBuffer::BLACK);
+    display.drawDitheredFastVLine(500, 20, 440, TriColorFrameBuffer::RED, 2);
+  } while (display.nextPage());
+  display.powerOff();
+}
+
+
+/// Checks the report of a full frame written in the given number of
+/// windows, which must cover all rows in order.
+void checkFullFrameCycle(const BoxlePanel& panel, size_t windowCount, const char* mode) {
+  char message[128];
+  const BoxlePanel::CycleReport& report = panel.getCycleReport();
+  snprintf(message, sizeof(message), "%s: %u window writes", mode, static_cast<unsigned>(windowCount));
+  check(panel.getWindowWrites().size() == windowCount, message);
+  int16_t nextRow = 0;
+  for (const BoxlePanel::WindowWrite& write : panel.getWindowWrites()) {
+    snprintf(message, sizeof(message), "%s: window at row %d covers full rows in order", mode, write.y);
+    check(write.x == 0 && write.w == BoxlePanel::WIDTH && write.y == nextRow, message);
+    nextRow = write.y + write.h;
+  }
+  snprintf(message, sizeof(message), "%s: all rows written", mode);
+  check(nextRow == BoxlePanel::HEIGHT, message);
+  snprintf(message, sizeof(message), "%s: both planes written once", mode);
+  check(report.writtenBytes == FRAME_BYTES, message);
+  snprintf(message, sizeof(message), "%s: one full refresh", mode);
+  check(report.fullRefreshCount == 1 && report.partialRefreshCount == 0, message);
+  snprintf(message, sizeof(message), "%s: one power cycle", mode);
+  check(report.powerCycleCount == 1 && report.powerMillis == BoxlePanel::power_on_time + BoxlePanel::power_off_time, message);
+  snprintf(message, sizeof(message), "%s: busy time of transfer, refresh, and power", mode);
+  check(report.refreshMillis == BoxlePanel::full_refresh_time &&
+        report.getBusyMillis() == report.transferMillis + BoxlePanel::full_refresh_time + report.powerMillis, message);
+}
+
+
+int main() {
+  TriColorDisplay<BoxlePanel> singlePageDisplay((BoxlePanel()));
+  singlePageDisplay.init();
+  renderFrame(singlePageDisplay);
+  checkFullFrameCycle(singlePageDisplay.epd2, 1, "single page");
+  // 2 * 81 * 480 bytes at 4 MHz.
+  check(singlePageDisplay.epd2.getCycleReport().transferMillis == 155, "single page: transfer time at the SPI clock");
+
+  // A small window in logical coordinates with rotation 2 is written from
+  // the opposite corner of the physical frame, aligned to full bytes.
+  singlePageDisplay.epd2.startCycle();
+  singlePageDisplay.updateWindow(0, 0, 100, 28);
+  singlePageDisplay.powerOff();
+  const std::vector<BoxlePanel::WindowWrite>& windowWrites = singlePageDisplay.epd2.getWindowWrites();
+  check(windowWrites.size() == 1, "window: one window write");
+  if (windowWrites.size() == 1) {
+    const BoxlePanel::WindowWrite& write = windowWrites[0];
+    check(write.x == 544 && write.y == 452 && write.w == 104 && write.h == 28, "window: physical window aligned to bytes");
+    check(write.bytes == 2 * 13 * 28, "window: bytes of both planes");
+  }
+  const BoxlePanel::CycleReport& windowReport = singlePageDisplay.epd2.getCycleReport();
+  check(windowReport.partialRefreshCount == (BoxlePanel::hasPartialUpdate ? 1 : 0) &&
+        windowReport.fullRefreshCount == (BoxlePanel::hasPartialUpdate ? 0 : 1), "window: refresh of the window");
+
+  TriColorDisplay<BoxlePanel> bandedDisplay((BoxlePanel()));
+  bandedDisplay.init();
+  bandedDisplay.enableBandPipeline(4, 1);
+  renderFrame(bandedDisplay);
+  checkFullFrameCycle(bandedDisplay.epd2, 4, "band pipeline");
+  check(memcmp(singlePageDisplay.getBlackPlane(), bandedDisplay.getBlackPlane(), PLANE_SIZE) == 0 &&
+        memcmp(singlePageDisplay.getRedPlane(), bandedDisplay.getRedPlane(), PLANE_SIZE) == 0,
+        "band pipeline: planes identical to the single page");
+
+  // The pipeline must be reusable for the next frame.
+  bandedDisplay.epd2.startCycle();
+  renderFrame(bandedDisplay);
+  checkFullFrameCycle(bandedDisplay.epd2, 4, "band pipeline, second frame");
+
+  if (failureCount == 0) {
+    printf("PASSED\n");
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <ctime>
+#include <vector>
+
+#include "plot_utility.h"
+
+
+/// Generates the ticks for a time axis whose values are given in seconds
+/// relative to the current time, i.e., from -range to 0. The ticks are
+/// aligned to full hours or to midnight and labeled with the time of day
+/// or the date (both UTC). The absolute tick times and their labels are
+/// cached, i.e., they are recomputed only if the range changes or the time
+/// passes the next tick. Only the positions relative to the current time
+/// are updated on each call.
+class TimeTickGenerator {
+ public:
+  /// Ctor expecting the maximum number of ticks on the axis.
+  explicit TimeTickGenerator(int maxTickCount)
+  : maxTickCount(maxTickCount)
+  {
+    assert(maxTickCount >= 2);
+  }
+
+
+  /// Returns the ticks for the range [-rangeSeconds, 0] ending at the given
+  /// current time.
+  const std::vector<PlotTick>& getTicks(long rangeSeconds, time_t now) {
+    assert(rangeSeconds > 0);
+
+    long step = getStepForRange(rangeSeconds, now);
+    time_t newestTick = getNewestTick(step, now);
+    if (rangeSeconds != cachedRangeSeconds || newestTick != cachedNewestTick) {
+      cachedTimes.clear();
+      cachedLabels.clear();
+      for (time_t tick = newestTick; tick >= now - rangeSeconds; tick -= step) {
+        tm tickTime;
+        gmtime_r(&tick, &tickTime);
+        char label[16];
+        if (step < SECONDS_PER_DAY && tick % SECONDS_PER_DAY != 0) {
+          strftime(label, sizeof(label), "%H:%M", &tickTime);
+        } else {
+          strftime(label, sizeof(label), "%d.%m.", &tickTime);
+        }
+        cachedTimes.insert(cachedTimes.begin(), tick);
+        cachedLabels.insert(cachedLabels.begin(), String(label));
+      }
+      cachedRangeSeconds = rangeSeconds;
+      cachedNewestTick = newestTick;
+    }
+
+    // As the time passes, the oldest ticks may drop out of the range.
+    ticks.clear();
+    for (size_t index = 0; index < cachedTimes.size(); ++index) {
+      if (cachedTimes[index] >= now - rangeSeconds) {
+        ticks.push_back({static_cast<double>(cachedTimes[index] - now), cachedLabels[index]});
+      }
+    }
+    return ticks;
+  }
+
+ private:
+  static const long SECONDS_PER_DAY = 24 * 3600;
+
+  const int maxTickCount;
+  long cachedRangeSeconds = 0;
+  time_t cachedNewestTick = 0;
+  std::vector<time_t> cachedTimes;  // Absolute, oldest first.
+  std::vector<String> cachedLabels;
+  std::vector<PlotTick> ticks;  // Relative to the time of the last call.
+
+
+  /// Returns the newest tick not after the given time for the given step.
+  /// All steps up to one day divide a day and are thus aligned to midnight,
+  /// larger steps (multiple days) start at the last midnight.
+  static time_t getNewestTick(long step, time_t now) {
+    return (step <= SECONDS_PER_DAY) ? (now / step) * step : (now / SECONDS_PER_DAY) * SECONDS_PER_DAY;
+  }
+
+
+  /// Returns the smallest step (in seconds) that yields at most the
+  /// maximum number of ticks for the given range ending at the given time.
+  long getStepForRange(long rangeSeconds, time_t now) const {
+    static const long STEPS[] = {3600, 2 * 3600, 3 * 3600, 6 * 3600, 12 * 3600, SECONDS_PER_DAY,
+                                 2 * SECONDS_PER_DAY, 4 * SECONDS_PER_DAY, 7 * SECONDS_PER_DAY,
+                                 14 * SECONDS_PER_DAY, 28 * SECONDS_PER_DAY};
+    for (long step : STEPS) {
+      time_t newestTick = getNewestTick(step, now);
+      if (newestTick < now - rangeSeconds || (newestTick - (now - rangeSeconds)) / step + 1 <= maxTickCount) {
+        return step;
+      }
+    }
+    return rangeSeconds;
+  }
+};
@@ -0,0 +1,499 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+
+#include <Adafruit_GFX.h>
+
+
+/// Frame buffer for a black/white/red display with one bit plane per color.
+/// The memory layout is identical to the one of GxEPD2_3C, i.e., eight
+/// pixels per byte with the leftmost pixel in the most significant bit. A
+/// set bit means white in the black plane and "not red" in the red plane.
+///
+/// Since the width is a multiple of eight, all rows form one contiguous bit
+/// stream. All filling operations (screen, rectangles, horizontal spans,
+/// and markers) are therefore implemented by a single kernel that updates
+/// both planes at once, 32 bits per memory access, instead of going pixel
+/// by pixel through drawPixel.
+class TriColorFrameBuffer : public Adafruit_GFX {
+ public:
+  /// Color codes as used by GxEPD2.
+  static const uint16_t WHITE = 0xFFFF;
+  static const uint16_t BLACK = 0x0000;
+  static const uint16_t RED = 0xF800;
+  static const uint16_t YELLOW = 0xFFE0;
+
+  /// Ctor expecting the physical (i.e., unrotated) size of the display.
+  TriColorFrameBuffer(int16_t physicalWidth, int16_t physicalHeight)
+  : Adafruit_GFX(physicalWidth, physicalHeight),
+    wordCount((physicalWidth * physicalHeight + 31) / 32),
+    blackPlane(new uint32_t[wordCount]),
+    redPlane(new uint32_t[wordCount]),
+    clipFirstRow(0),
+    clipEndRow(physicalHeight)
+  {
+    assert(physicalWidth % 8 == 0);
+    fillPlanes(0, wordCount, WHITE);
+  }
+
+  ~TriColorFrameBuffer() {
+    delete[] blackPlane;
+    delete[] redPlane;
+  }
+
+  TriColorFrameBuffer(const TriColorFrameBuffer&) = delete;
+  TriColorFrameBuffer& operator=(const TriColorFrameBuffer&) = delete;
+
+
+  /// Returns the black plane in the byte layout expected by GxEPD2.
+  const uint8_t* getBlackPlane() const {
+    return reinterpret_cast<const uint8_t*>(blackPlane);
+  }
+
+
+  /// Returns the red plane in the byte layout expected by GxEPD2.
+  const uint8_t* getRedPlane() const {
+    return reinterpret_cast<const uint8_t*>(redPlane);
+  }
+
+
+  /// Returns the size of each plane in bytes.
+  size_t getPlaneSize() const {
+    return wordCount * sizeof(uint32_t);
+  }
+
+
+  /// Restricts all drawing to the physical rows [firstRow, endRow), e.g.,
+  /// to render the screen in bands.
+  void setClipRows(int16_t firstRow, int16_t endRow) {
+    clipFirstRow = std::max<int16_t>(firstRow, 0);
+    clipEndRow = std::min<int16_t>(endRow, HEIGHT);
+  }
+
+
+  /// Sets a single pixel in logical (i.e., rotated) coordinates.
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (!toPhysical(x, y) || y < clipFirstRow || y >= clipEndRow) {
+      return;
+    }
+    uint32_t bit = static_cast<uint32_t>(y) * WIDTH + x;
+    uint8_t mask = 0x80 >> (bit & 7);
+    uint8_t* black = reinterpret_cast<uint8_t*>(blackPlane) + bit / 8;
+    uint8_t* red = reinterpret_cast<uint8_t*>(redPlane) + bit / 8;
+    if (isRed(color)) {
+      *black |= mask;
+      *red &= ~mask;
+    } else if (color == WHITE) {
+      *black |= mask;
+      *red |= mask;
+    } else {
+      *black &= ~mask;
+      *red |= mask;
+    }
+  }
+
+
+  /// Fills the whole frame buffer with the given color.
+  void fillScreen(uint16_t color) override {
+    if (clipFirstRow == 0 && clipEndRow == HEIGHT) {
+      fillPlanes(0, wordCount, color);
+    } else if (clipFirstRow < clipEndRow) {
+      fillBits(static_cast<uint32_t>(clipFirstRow) * WIDTH, static_cast<uint32_t>(clipEndRow) * WIDTH, color);
+    }
+  }
+
+
+  /// Fills the given rectangle in logical (i.e., rotated) coordinates.
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    if (w < 0) {
+      x += w + 1;
+      w = -w;
+    }
+    if (h < 0) {
+      y += h + 1;
+      h = -h;
+    }
+    int32_t x0 = x;
+    int32_t y0 = y;
+    int32_t x1 = x + w;
+    int32_t y1 = y + h;
+    rectToPhysical(x0, y0, x1, y1);
+    x0 = std::max<int32_t>(x0, 0);
+    y0 = std::max<int32_t>(y0, clipFirstRow);
+    x1 = std::min<int32_t>(x1, WIDTH);
+    y1 = std::min<int32_t>(y1, clipEndRow);
+    if (x0 >= x1 || y0 >= y1) {
+      return;
+    }
+    if (x0 == 0 && x1 == WIDTH) {
+      // Full rows are contiguous in the bit stream.
+      fillBits(static_cast<uint32_t>(y0) * WIDTH, static_cast<uint32_t>(y1) * WIDTH, color);
+      return;
+    }
+    for (int32_t row = y0; row < y1; ++row) {
+      uint32_t rowStart = static_cast<uint32_t>(row) * WIDTH;
+      fillBits(rowStart + x0, rowStart + x1, color);
+    }
+  }
+
+
+  /// Draws a horizontal span in logical (i.e., rotated) coordinates.
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+    fillRect(x, y, w, 1, color);
+  }
+
+
+  /// Draws a vertical span in logical (i.e., rotated) coordinates.
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+    fillRect(x, y, 1, h, color);
+  }
+
+
+  /// Stamps a square marker of the given size centered at x,y.
+  void stampMarker(int16_t x, int16_t y, int16_t size, uint16_t color) {
+    fillRect(x - size / 2, y - size / 2, size, size, color);
+  }
+
+
+  /// Draws a vertical span in logical (i.e., rotated) coordinates using an
+  /// ordered (4x4 Bayer) dithering. Only the pixels whose threshold is below
+  /// the given level (0 to 16) are set, i.e., level 16 gives a solid line.
+  /// The pattern is anchored to the physical pixel grid so that adjacent
+  /// spans form a seamless texture.
+  void drawDitheredFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color, uint8_t level) {
+    static const uint8_t BAYER_4X4[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+    for (int16_t row = y; row < y + h; ++row) {
+      int16_t px = x;
+      int16_t py = row;
+      if (toPhysical(px, py) && BAYER_4X4[py & 3][px & 3] < level) {
+        drawPixel(x, row, color);
+      }
+    }
+  }
+
+ protected:
+  /// Converts the given logical half-open rectangle [x0, x1) x [y0, y1)
+  /// into a physical one clipped to the frame buffer and extended to full
+  /// bytes horizontally. Returns false if the rectangle is empty.
+  bool windowToPhysical(int32_t& x0, int32_t& y0, int32_t& x1, int32_t& y1) const {
+    rectToPhysical(x0, y0, x1, y1);
+    x0 = std::max<int32_t>(x0, 0) & ~7;
+    y0 = std::max<int32_t>(y0, 0);
+    x1 = (std::min<int32_t>(x1, WIDTH) + 7) & ~7;
+    y1 = std::min<int32_t>(y1, HEIGHT);
+    return x0 < x1 && y0 < y1;
+  }
+
+ private:
+  const uint32_t wordCount;
+  uint32_t* const blackPlane;
+  uint32_t* const redPlane;
+  int16_t clipFirstRow;
+  int16_t clipEndRow;
+
+
+  static bool isRed(uint16_t color) {
+    return color == RED || color == YELLOW;
+  }
+
+
+  /// Returns the 32-bit patterns to be written to the black and red planes
+  /// for the given color.
+  static void getPlanePatterns(uint16_t color, uint32_t& blackPattern, uint32_t& redPattern) {
+    blackPattern = (color == WHITE || isRed(color)) ? 0xFFFFFFFF : 0x00000000;
+    redPattern = isRed(color) ? 0x00000000 : 0xFFFFFFFF;
+  }
+
+
+  /// Converts a mask given in bit-stream order (bit 31 is the first pixel)
+  /// into the native order of a word loaded from the byte-oriented planes.
+  static uint32_t toNativeMask(uint32_t streamMask) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return __builtin_bswap32(streamMask);
+#else
+    return streamMask;
+#endif
+  }
+
+
+  /// Fills the words [firstWord, endWord) of both planes with the given color.
+  void fillPlanes(uint32_t firstWord, uint32_t endWord, uint16_t color) {
+    uint32_t blackPattern;
+    uint32_t redPattern;
+    getPlanePatterns(color, blackPattern, redPattern);
+    for (uint32_t index = firstWord; index < endWord; ++index) {
+      blackPlane[index] = blackPattern;
+      redPlane[index] = redPattern;
+    }
+  }
+
+
+  /// Fills the bits [firstBit, endBit) of the bit stream in both planes
+  /// with the given color. Only the partial words at the beginning and the
+  /// end need a read-modify-write.
+  void fillBits(uint32_t firstBit, uint32_t endBit, uint16_t color) {
+    uint32_t blackPattern;
+    uint32_t redPattern;
+    getPlanePatterns(color, blackPattern, redPattern);
+    uint32_t firstWord = firstBit / 32;
+    uint32_t lastWord = (endBit - 1) / 32;
+    uint32_t headMask = toNativeMask(0xFFFFFFFF >> (firstBit % 32));
+    uint32_t tailMask = toNativeMask(0xFFFFFFFF << (31 - (endBit - 1) % 32));
+    if (firstWord == lastWord) {
+      uint32_t mask = headMask & tailMask;
+      blackPlane[firstWord] = (blackPlane[firstWord] & ~mask) | (blackPattern & mask);
+      redPlane[firstWord] = (redPlane[firstWord] & ~mask) | (redPattern & mask);
+      return;
+    }
+    blackPlane[firstWord] = (blackPlane[firstWord] & ~headMask) | (blackPattern & headMask);
+    redPlane[firstWord] = (redPlane[firstWord] & ~headMask) | (redPattern & headMask);
+    for (uint32_t index = firstWord + 1; index < lastWord; ++index) {
+      blackPlane[index] = blackPattern;
+      redPlane[index] = redPattern;
+    }
+    blackPlane[lastWord] = (blackPlane[lastWord] & ~tailMask) | (blackPattern & tailMask);
+    redPlane[lastWord] = (redPlane[lastWord] & ~tailMask) | (redPattern & tailMask);
+  }
+
+
+  /// Converts the given logical pixel position into a physical one. Returns
+  /// false if the pixel is outside of the frame buffer.
+  bool toPhysical(int16_t& x, int16_t& y) const {
+    if (x < 0 || x >= width() || y < 0 || y >= height()) {
+      return false;
+    }
+    int16_t t;
+    switch (getRotation()) {
+      case 1:
+        t = x;
+        x = WIDTH - 1 - y;
+        y = t;
+        break;
+      case 2:
+        x = WIDTH - 1 - x;
+        y = HEIGHT - 1 - y;
+        break;
+      case 3:
+        t = x;
+        x = y;
+        y = HEIGHT - 1 - t;
+        break;
+    }
+    return true;
+  }
+
+
+  /// Converts the given logical half-open rectangle [x0, x1) x [y0, y1)
+  /// into a physical one.
+  void rectToPhysical(int32_t& x0, int32_t& y0, int32_t& x1, int32_t& y1) const {
+    int32_t t0 = x0;
+    int32_t t1 = x1;
+    switch (getRotation()) {
+      case 1:
+        x0 = WIDTH - y1;
+        x1 = WIDTH - y0;
+        y0 = t0;
+        y1 = t1;
+        break;
+      case 2:
+        x0 = WIDTH - x1;
+        x1 = WIDTH - t0;
+        t0 = y0;
+        y0 = HEIGHT - y1;
+        y1 = HEIGHT - t0;
+        break;
+      case 3:
+        x0 = y0;
+        x1 = y1;
+        y0 = HEIGHT - t1;
+        y1 = HEIGHT - t0;
+        break;
+    }
+  }
+};
+
+
+/// Display driving a GxEPD2 panel (e.g., GxEPD2_583c_Z83) from a full
+/// TriColorFrameBuffer. It mirrors the paging interface of GxEPD2_3C so
+/// that rendering code can be written the same way. By default, the whole
+/// screen is rendered as a single page.
+///
+/// With a band pipeline, the screen is rendered in horizontal bands (i.e.,
+/// pages) of physical rows instead. Each band is written to the panel by a
+/// transfer task on another core while the next band is rendered. Since
+/// the bands are disjoint parts of the full frame buffer, no additional
+/// buffer is needed. The refresh starts once all bands are written.
+template <typename Panel>
+class TriColorDisplay : public TriColorFrameBuffer {
+ public:
+  explicit TriColorDisplay(const Panel& panel)
+  : TriColorFrameBuffer(Panel::WIDTH, Panel::HEIGHT), epd2(panel) {}
+
+  TriColorDisplay(const TriColorDisplay&) = delete;
+  TriColorDisplay& operator=(const TriColorDisplay&) = delete;
+
+  /// Initializes the panel, cf. GxEPD2_3C::init.
+  void init(uint32_t serialDiagBitrate = 0) {
+    epd2.init(serialDiagBitrate);
+  }
+
+  /// Makes the whole screen the target of the next refresh.
+  void setFullWindow() {}
+
+  /// Enables the band pipeline with the given number of bands (1 disables
+  /// it) and the transfer task on the given core.
+  void enableBandPipeline(int count, BaseType_t transferCore) {
+    bandCount = std::max(count, 1);
+    if (bandCount > 1 && bandQueue == nullptr) {
+      bandQueue = xQueueCreate(MAX_BAND_COUNT, sizeof(int));
+      bandWrittenSemaphore = xSemaphoreCreateCounting(MAX_BAND_COUNT, 0);
+      xTaskCreatePinnedToCore(transferTaskMain, "bandTransferTask", 4096, this, 2, nullptr, transferCore);
+    }
+    bandCount = std::min(bandCount, MAX_BAND_COUNT);
+  }
+
+  /// Starts the rendering of a new frame.
+  void firstPage() {
+    currentBand = 0;
+    writeMicros = 0;
+    if (bandCount > 1) {
+      setClipRows(getBandFirstRow(0), getBandFirstRow(1));
+    }
+  }
+
+  /// Sets a function that writes the given rows of both planes to the panel
+  /// instead of Panel::writeImage, e.g., by DMA. The pointers point to the
+  /// first row. It is used for the bands in band pipeline mode and for the
+  /// whole screen otherwise.
+  void setBandWriter(std::function<void(const uint8_t* black, const uint8_t* red, int16_t firstRow, int16_t rowCount)> writer) {
+    bandWriter = writer;
+  }
+
+  /// Transfers the frame buffer to the panel and performs a full refresh.
+  /// In band pipeline mode, the current band is handed to the transfer task
+  /// and true is returned until the last band has been rendered. Otherwise,
+  /// always returns false as there is only one page.
+  bool nextPage() {
+    if (bandCount > 1) {
+      xQueueSend(bandQueue, &currentBand, portMAX_DELAY);
+      if (++currentBand < bandCount) {
+        setClipRows(getBandFirstRow(currentBand), getBandFirstRow(currentBand + 1));
+        return true;
+      }
+      unsigned long waitStartMicros = micros();
+      for (int band = 0; band < bandCount; ++band) {
+        xSemaphoreTake(bandWrittenSemaphore, portMAX_DELAY);
+      }
+      lastWriteMicros = micros() - waitStartMicros;  // Only the part not hidden by rendering.
+      setClipRows(0, Panel::HEIGHT);
+      epd2.refresh(false);
+      return false;
+    }
+
+    unsigned long writeStartMicros = micros();
+    writeRows(0, Panel::HEIGHT);
+    lastWriteMicros = micros() - writeStartMicros;
+    epd2.refresh(false);
+    return false;
+  }
+
+  /// Writes the given window in logical (i.e., rotated) coordinates to the
+  /// panel and refreshes only this window, e.g., for a small indicator.
+  void updateWindow(int16_t x, int16_t y, int16_t w, int16_t h) {
+    int32_t x0 = x;
+    int32_t y0 = y;
+    int32_t x1 = x + w;
+    int32_t y1 = y + h;
+    if (!windowToPhysical(x0, y0, x1, y1)) {
+      return;
+    }
+    epd2.writeImagePart(getBlackPlane(), getRedPlane(), x0, y0, Panel::WIDTH, Panel::HEIGHT, x0, y0, x1 - x0, y1 - y0);
+    epd2.refresh(x0, y0, x1 - x0, y1 - y0);
+  }
+
+  /// Returns the duration of the last write of the planes to the panel,
+  /// i.e., without the refresh. In band pipeline mode, only the time spent
+  /// waiting for the transfer after rendering is included.
+  unsigned long getLastWriteMicros() const {
+    return lastWriteMicros;
+  }
+
+  /// Returns the total duration of all writes of the last frame, also the
+  /// ones hidden by rendering in band pipeline mode.
+  unsigned long getLastTotalWriteMicros() const {
+    return writeMicros;
+  }
+
+  /// Powers off the panel, cf. GxEPD2_3C::powerOff.
+  void powerOff() {
+    epd2.powerOff();
+  }
+
+  Panel epd2;
+
+ private:
+  static const int MAX_BAND_COUNT = 16;
+
+  std::function<void(const uint8_t*, const uint8_t*, int16_t, int16_t)> bandWriter;
+  unsigned long lastWriteMicros = 0;
+  unsigned long writeMicros = 0;  // Sum of all writes of the current frame.
+  int bandCount = 1;
+  int currentBand = 0;
+  QueueHandle_t bandQueue = nullptr;
+  SemaphoreHandle_t bandWrittenSemaphore = nullptr;
+
+
+  /// Returns the first row of the given band. The bands are multiples of
+  /// four rows high, so that each band starts word-aligned in the planes
+  /// (e.g., for DMA).
+  int16_t getBandFirstRow(int band) const {
+    int32_t bandRows = ((Panel::HEIGHT + bandCount - 1) / bandCount + 3) / 4 * 4;
+    return static_cast<int16_t>(std::min<int32_t>(static_cast<int32_t>(band) * bandRows, Panel::HEIGHT));
+  }
+
+
+  /// Writes the rows of the given band of both planes to the panel.
+  void writeBand(int band) {
+    int16_t firstRow = getBandFirstRow(band);
+    int16_t endRow = getBandFirstRow(band + 1);
+    if (firstRow < endRow) {
+      writeRows(firstRow, endRow - firstRow);
+    }
+  }
+
+
+  /// Writes the given rows of both planes to the panel.
+  void writeRows(int16_t firstRow, int16_t rowCount) {
+    unsigned long writeStartMicros = micros();
+    uint32_t offset = static_cast<uint32_t>(firstRow) * (Panel::WIDTH / 8);
+    if (bandWriter) {
+      bandWriter(getBlackPlane() + offset, getRedPlane() + offset, firstRow, rowCount);
+    } else {
+      epd2.writeImage(getBlackPlane() + offset, getRedPlane() + offset, 0, firstRow, Panel::WIDTH, rowCount);
+    }
+    writeMicros += micros() - writeStartMicros;
+  }
+
+
+  /// The main function of the transfer task, which writes the bands in the
+  /// order they are rendered.
+  static void transferTaskMain(void* parameter) {
+    TriColorDisplay* display = static_cast<TriColorDisplay*>(parameter);
+    int band;
+    while (true) {
+      if (xQueueReceive(display->bandQueue, &band, portMAX_DELAY) == pdTRUE) {
+        display->writeBand(band);
+        xSemaphoreGive(display->bandWrittenSemaphore);
+      }
+    }
+  }
+};
@@ -0,0 +1,109 @@
+// Copyright (c) 2024-2025 Ralph Lange
+// All rights reserved.
+//
+// This source code is licensed under the BSD 3-Clause license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+
+/// Generates test signals (sine, ramp, step, and sine sweep) with values
+/// from 0 to 255 for an analog meter at a fixed sample rate, e.g., driven
+/// by a hardware timer. The signal is computed by a 32-bit phase
+/// accumulator and a precomputed sine table, i.e., only integer operations
+/// are needed per sample. This file is shared with the tool
+/// tools/analog_out_sinus.
+class WaveformGenerator {
+ public:
+  enum class Shape {
+    SINE,
+    RAMP,  // Sawtooth from 0 to 255.
+    STEP,  // Square wave between 0 and 255.
+    SWEEP  // Sine with linearly increasing frequency, restarting periodically.
+  };
+
+
+  /// Ctor expecting the sample rate, i.e., the rate at which
+  /// getNextSample() is called.
+  explicit WaveformGenerator(uint32_t sampleRateHz)
+  : sampleRateHz(sampleRateHz)
+  {
+    assert(sampleRateHz > 0);
+    for (int index = 0; index < TABLE_SIZE; ++index) {
+      sineTable[index] = static_cast<uint8_t>(std::lround(127.5 + 127.5 * std::sin(2.0 * M_PI * index / TABLE_SIZE)));
+    }
+    configure(Shape::SINE, 0.25f);
+  }
+
+
+  /// Sets the shape and the frequency. For a sweep, the frequency rises
+  /// from frequencyHz to sweepEndFrequencyHz within sweepSeconds.
+  void configure(Shape newShape, float frequencyHz, float sweepEndFrequencyHz = 0.0f, float sweepSeconds = 0.0f) {
+    shape = newShape;
+    phase = 0;
+    startIncrement = getPhaseIncrement(frequencyHz);
+    increment = startIncrement;
+    incrementDelta = 0;
+    sweepSampleCount = 0;
+    if (shape == Shape::SWEEP && sweepSeconds > 0.0f) {
+      sweepSampleCount = static_cast<uint32_t>(sweepSeconds * sampleRateHz);
+      incrementDelta = (static_cast<int64_t>(getPhaseIncrement(sweepEndFrequencyHz)) - startIncrement) / std::max<int64_t>(sweepSampleCount, 1);
+    }
+    sampleIndex = 0;
+  }
+
+
+  /// Returns the next sample (0 to 255). Integer operations only.
+  uint8_t getNextSample() {
+    uint8_t tableIndex = phase >> 24;
+    uint8_t sample;
+    switch (shape) {
+      case Shape::RAMP:
+        sample = tableIndex;
+        break;
+      case Shape::STEP:
+        sample = (phase < 0x80000000u) ? 255 : 0;
+        break;
+      default:
+        sample = sineTable[tableIndex];
+        break;
+    }
+
+    phase += increment;
+    if (shape == Shape::SWEEP && sweepSampleCount > 0) {
+      if (++sampleIndex >= sweepSampleCount) {
+        sampleIndex = 0;
+        increment = startIncrement;
+      } else {
+        increment += incrementDelta;
+      }
+    }
+    return sample;
+  }
+
+ private:
+  static const int TABLE_SIZE = 256;
+
+  const uint32_t sampleRateHz;
+  uint8_t sineTable[TABLE_SIZE];
+  Shape shape = Shape::SINE;
+  uint32_t phase = 0;
+  uint32_t increment = 0;
+  uint32_t startIncrement = 0;
+  int32_t incrementDelta = 0;
+  uint32_t sweepSampleCount = 0;
+  uint32_t sampleIndex = 0;
+
+
+  /// Returns the phase increment per sample for the given frequency, where
+  /// 2^32 is a full period.
+  uint32_t getPhaseIncrement(float frequencyHz) const {
+    return static_cast<uint32_t>(std::min(std::max(frequencyHz / sampleRateHz, 0.0f), 0.5f) * 4294967296.0);
+  }
+};
@@ -5,20 +5,52 @@
 // LICENSE file in the root directory of this source tree.
 
 
+// Symbolic link to the file in src/smart_home_boxle. The Arduino IDE copies
+// the sketch into a build folder, so a relative include of the original
+// file would not be found. On Windows, check out with symbolic links
+// enabled (git clone -c core.symlinks=true) or replace the link by a copy.
+#include "waveform_generator.h"
+
+
 const int AMMETER_PIN = 25;
-const float SINUS_FREQUENCY = 0.25f;
+const WaveformGenerator::Shape SHAPE = WaveformGenerator::Shape::SINE;
+const float FREQUENCY = 0.25f;
+const float SWEEP_END_FREQUENCY = 5.0f;  // Only for Shape::SWEEP.
+const float SWEEP_SECONDS = 60.0f;  // Only for Shape::SWEEP.
+const uint32_t SAMPLE_RATE_HZ = 1000;
+const uint32_t PRINT_EVERY_NTH_SAMPLE = 25;
+
+WaveformGenerator generator(SAMPLE_RATE_HZ);
+TaskHandle_t loopTask = NULL;
+hw_timer_t* sampleTimer = NULL;
+
+
+void IRAM_ATTR onSampleTimer() {
+  BaseType_t isHigherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTask, &isHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(isHigherPriorityTaskWoken);
+}
 
 
 void setup() {
   Serial.begin(115200);
   pinMode(AMMETER_PIN, OUTPUT);
+  generator.configure(SHAPE, FREQUENCY, SWEEP_END_FREQUENCY, SWEEP_SECONDS);
+
+  loopTask = xTaskGetCurrentTaskHandle();
+  sampleTimer = timerBegin(0, 80, true);  // 1 MHz
+  timerAttachInterrupt(sampleTimer, onSampleTimer, true);
+  timerAlarmWrite(sampleTimer, 1000000 / SAMPLE_RATE_HZ, true);
+  timerAlarmEnable(sampleTimer);
 }
 
 
 void loop() {
-  float uptimeInSeconds = millis() / 1000.0f;
-  int i = 128 + static_cast<int>(127.0f * sin(SINUS_FREQUENCY * 2.0f * PI * uptimeInSeconds));
-  Serial.println(i);
+  static uint32_t sampleCount = 0;
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  uint8_t i = generator.getNextSample();
   analogWrite(AMMETER_PIN, i);  // i=0 to 255 gives output range from 0.0 to 3.3 V
-  delay(25);
+  if (++sampleCount % PRINT_EVERY_NTH_SAMPLE == 0) {
+    Serial.println(i);
+  }
 }
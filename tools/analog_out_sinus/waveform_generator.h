@@ -0,0 +1 @@
+../../src/smart_home_boxle/waveform_generator.h
\ No newline at end of file